@@ -0,0 +1,79 @@
+// Linked into every benchmarked program. Counts calls to the global operator
+// new and writes the running total to stderr on SIGUSR2, so that run.sh can
+// sample it before and after a load test.
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<unsigned long long> allocations{0};
+
+void* allocate(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+  void* p = nullptr;
+  if (::posix_memalign(&p, align, size ? size : 1) == 0)
+    return p;
+  throw std::bad_alloc();
+}
+
+void report(int)
+{
+  static const char prefix[] = "allocations ";
+  char text[32];
+  char* end = text + sizeof(text);
+  char* p = end;
+  *--p = '\n';
+  unsigned long long n = allocations.load(std::memory_order_relaxed);
+  do
+  {
+    *--p = static_cast<char>('0' + n % 10);
+    n /= 10;
+  } while (n != 0);
+
+  ssize_t result = ::write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+  result = ::write(STDERR_FILENO, p, end - p);
+  (void)result;
+}
+
+struct install_report_handler
+{
+  install_report_handler()
+  {
+    struct sigaction action{};
+    action.sa_handler = report;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGUSR2, &action, nullptr);
+  }
+} installer;
+
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t a) { return allocate(size, a); }
+void* operator new[](std::size_t size, std::align_val_t a) { return allocate(size, a); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
@@ -0,0 +1,90 @@
+#include <array>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> echo(tcp::socket socket)
+{
+  std::error_code ec;
+  socket.set_option(tcp::no_delay(true), ec);
+
+  std::array<char, 65536> data;
+
+  for (;;)
+  {
+    auto [e1, n1] = co_await socket.async_read_some(buffer(data), use_nothrow_awaitable);
+    if (e1)
+      break;
+
+    auto [e2, n2] = co_await async_write(socket, buffer(data, n1), use_nothrow_awaitable);
+    if (e2)
+      break;
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor)
+{
+  for (;;)
+  {
+    auto [e, socket] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = socket.get_executor();
+    co_spawn(ex, echo(std::move(socket)), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 3 && argc != 4)
+    {
+      std::cerr << "Usage: echo_server";
+      std::cerr << " <listen_address> <listen_port> [<threads>]\n";
+      return 1;
+    }
+
+    std::size_t num_threads = argc == 4 ? std::stoul(argv[3]) : 1;
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor), detached);
+
+    // With more than one thread, a session that hogs one thread cannot delay
+    // the others, so the backend does not distort fairness measurements.
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < num_threads; ++i)
+      threads.emplace_back([&ctx]{ ctx.run(); });
+
+    ctx.run();
+
+    for (auto& t : threads)
+      t.join();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
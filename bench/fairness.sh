@@ -0,0 +1,80 @@
+#!/bin/bash
+#
+# Usage: fairness.sh
+#
+# Measures the latency of small interactive sessions that share the proxy's
+# thread with bulk transfers, with the fairness policy in performance/step_19
+# disabled and then enabled. The load can be changed with the BULK_CONNECTIONS,
+# BULK_MESSAGE_SIZE, INTERACTIVE_CONNECTIONS, RATE and DURATION environment
+# variables.
+
+set -eu
+
+cd "$(dirname "$0")"
+
+BULK_CONNECTIONS=${BULK_CONNECTIONS:-4}
+BULK_MESSAGE_SIZE=${BULK_MESSAGE_SIZE:-1048576}
+INTERACTIVE_CONNECTIONS=${INTERACTIVE_CONNECTIONS:-16}
+RATE=${RATE:-1000}
+DURATION=${DURATION:-10}
+ECHO_PORT=${ECHO_PORT:-55555}
+PROXY_PORT=${PROXY_PORT:-55556}
+
+wait_for_port()
+{
+  for _ in $(seq 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+      return 0
+    fi
+    sleep 0.1
+  done
+  return 1
+}
+
+field()
+{
+  tr ' ' '\n' <<< "$1" | awk -F= -v key="$2" '$1 == key { print $2 }'
+}
+
+bin/echo_server 127.0.0.1 "$ECHO_PORT" 4 &
+ECHO_PID=$!
+trap 'kill $ECHO_PID 2>/dev/null || true' EXIT
+wait_for_port "$ECHO_PORT"
+
+BULK=$(mktemp)
+
+printf "%-28s %10s %10s %10s %10s %12s\n" \
+  policy "p50_us" "p99_us" "p999_us" "max_us" "bulk_MB/s"
+
+for policy in "0 0" "65536 16"; do
+  # shellcheck disable=SC2086
+  bin/performance_step_19 127.0.0.1 "$PROXY_PORT" 127.0.0.1 "$ECHO_PORT" $policy &
+  PROXY_PID=$!
+  wait_for_port "$PROXY_PORT"
+
+  bin/load_client 127.0.0.1 "$PROXY_PORT" \
+    "$BULK_CONNECTIONS" "$BULK_MESSAGE_SIZE" "$DURATION" > "$BULK" &
+  BULK_PID=$!
+
+  INTERACTIVE=$(bin/load_generator 127.0.0.1 "$PROXY_PORT" \
+    "$INTERACTIVE_CONNECTIONS" "$RATE" 64 "$DURATION")
+
+  wait "$BULK_PID" || true
+  kill "$PROXY_PID" 2>/dev/null || true
+  wait "$PROXY_PID" 2>/dev/null || true
+
+  if [ "$policy" = "0 0" ]; then
+    name="off"
+  else
+    name="on ($(cut -d' ' -f1 <<< "$policy") bytes, $(cut -d' ' -f2 <<< "$policy") reads)"
+  fi
+
+  printf "%-28s %10s %10s %10s %10s %12s\n" "$name" \
+    "$(field "$INTERACTIVE" p50_us)" \
+    "$(field "$INTERACTIVE" p99_us)" \
+    "$(field "$INTERACTIVE" p999_us)" \
+    "$(field "$INTERACTIVE" max_us)" \
+    "$(field "$(cat "$BULK")" mb_per_second)"
+done
+
+rm -f "$BULK"
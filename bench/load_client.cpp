@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using std::chrono::steady_clock;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+struct results
+{
+  std::vector<steady_clock::duration> latencies;
+  std::uint64_t bytes = 0;
+  std::uint64_t errors = 0;
+};
+
+// Sends a message and waits for the whole echo before sending the next one,
+// until the end time is reached.
+awaitable<void> run_connection(tcp::endpoint target,
+    std::size_t message_size, steady_clock::time_point end, results& r)
+{
+  tcp::socket socket(co_await this_coro::executor);
+
+  auto [e] = co_await socket.async_connect(target, use_nothrow_awaitable);
+  if (e)
+  {
+    ++r.errors;
+    co_return;
+  }
+
+  std::error_code ec;
+  socket.set_option(tcp::no_delay(true), ec);
+
+  std::vector<char> request(message_size, 'x');
+  std::vector<char> response(message_size);
+
+  while (steady_clock::now() < end)
+  {
+    auto start = steady_clock::now();
+
+    auto [e1, n1] = co_await async_write(socket, buffer(request), use_nothrow_awaitable);
+    if (e1)
+    {
+      ++r.errors;
+      break;
+    }
+
+    auto [e2, n2] = co_await async_read(socket, buffer(response), use_nothrow_awaitable);
+    if (e2)
+    {
+      ++r.errors;
+      break;
+    }
+
+    r.latencies.push_back(steady_clock::now() - start);
+    r.bytes += n1 + n2;
+  }
+}
+
+double percentile_us(const std::vector<steady_clock::duration>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  std::size_t i = std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()));
+  return std::chrono::duration<double, std::micro>(sorted[i]).count();
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 6)
+    {
+      std::cerr << "Usage: load_client";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " <connections> <message_size> <seconds>\n";
+      return 1;
+    }
+
+    std::size_t connections = std::stoul(argv[3]);
+    std::size_t message_size = std::stoul(argv[4]);
+    std::chrono::seconds duration(std::stoul(argv[5]));
+
+    asio::io_context ctx(1);
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2]
+        );
+
+    results r;
+    auto start = steady_clock::now();
+
+    for (std::size_t i = 0; i < connections; ++i)
+    {
+      co_spawn(ctx,
+          run_connection(target_endpoint, message_size, start + duration, r),
+          detached);
+    }
+
+    ctx.run();
+
+    double seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    std::sort(r.latencies.begin(), r.latencies.end());
+
+    std::cout << "requests=" << r.latencies.size();
+    std::cout << " errors=" << r.errors;
+    std::cout << " bytes=" << r.bytes;
+    std::cout << " seconds=" << seconds;
+    std::cout << " requests_per_second=" << r.latencies.size() / seconds;
+    std::cout << " mb_per_second=" << r.bytes / seconds / 1e6;
+    std::cout << " p50_us=" << percentile_us(r.latencies, 0.5);
+    std::cout << " p99_us=" << percentile_us(r.latencies, 0.99);
+    std::cout << " p999_us=" << percentile_us(r.latencies, 0.999);
+    std::cout << "\n";
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+// Records values in the same log-linear layout as HdrHistogram. Values below
+// 2^precision_bits are counted exactly. Above that, each power of two is
+// split into 2^(precision_bits - 1) equal buckets, so that any value is
+// reported to within 0.2% of its true size.
+class histogram
+{
+public:
+  static constexpr unsigned precision_bits = 10;
+
+  histogram()
+    : counts_(index_of(~std::uint64_t(0)) + 1)
+  {
+  }
+
+  void record(std::uint64_t value)
+  {
+    ++counts_[index_of(value)];
+    ++total_;
+    if (value > max_)
+      max_ = value;
+  }
+
+  std::uint64_t total() const
+  {
+    return total_;
+  }
+
+  std::uint64_t max() const
+  {
+    return max_;
+  }
+
+  // Returns the highest value that is equivalent to the given percentile.
+  std::uint64_t value_at_percentile(double percentile) const
+  {
+    if (total_ == 0)
+      return 0;
+
+    auto target = static_cast<std::uint64_t>(percentile / 100.0 * total_ + 0.5);
+    if (target == 0)
+      target = 1;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i)
+    {
+      seen += counts_[i];
+      if (seen >= target)
+        return std::min(highest_equivalent(i), max_);
+    }
+
+    return max_;
+  }
+
+private:
+  static constexpr std::uint64_t linear_limit = std::uint64_t(1) << precision_bits;
+  static constexpr std::uint64_t half_limit = linear_limit / 2;
+
+  static std::size_t index_of(std::uint64_t value)
+  {
+    if (value < linear_limit)
+      return value;
+
+    unsigned shift = std::bit_width(value) - precision_bits;
+    return linear_limit + (shift - 1) * half_limit + ((value >> shift) - half_limit);
+  }
+
+  static std::uint64_t highest_equivalent(std::size_t index)
+  {
+    if (index < linear_limit)
+      return index;
+
+    unsigned shift = (index - linear_limit) / half_limit + 1;
+    std::uint64_t sub_bucket = (index - linear_limit) % half_limit + half_limit;
+    return (sub_bucket << shift) + ((std::uint64_t(1) << shift) - 1);
+  }
+
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t total_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+struct results
+{
+  histogram latencies; // nanoseconds
+  std::uint64_t bytes = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t dropped = 0; // scheduled but never sent
+};
+
+// Latency is measured from when a request was due to be sent, not from when
+// it was actually sent. A stalled proxy therefore shows up in the results as
+// a queue of late requests, instead of silently lowering the request rate.
+void record_latency(results& r, steady_clock::time_point intended)
+{
+  auto latency = steady_clock::now() - intended;
+  r.latencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+}
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+struct schedule
+{
+  steady_clock::time_point first;
+  steady_clock::duration interval;
+  steady_clock::time_point end;
+};
+
+// Returns how many of the schedule's send times fall at or after from, which
+// must itself be one of them.
+std::uint64_t requests_from(const schedule& s, steady_clock::time_point from)
+{
+  if (from >= s.end)
+    return 0;
+  return (s.end - from + s.interval - steady_clock::duration(1)) / s.interval;
+}
+
+struct in_flight
+{
+  std::deque<steady_clock::time_point> intended;
+  bool sending = true;
+};
+
+// Sends requests on schedule whether or not earlier responses have arrived.
+// If the connection fails, the requests it had yet to send are counted as
+// dropped, so that they are not silently missing from the results.
+awaitable<void> send_requests(tcp::socket& socket,
+    std::size_t message_size, schedule s, in_flight& pending, results& r)
+{
+  asio::steady_timer timer(socket.get_executor());
+  std::vector<char> request(message_size, 'x');
+
+  for (auto intended = s.first; intended < s.end; intended += s.interval)
+  {
+    if (steady_clock::now() < intended)
+    {
+      timer.expires_at(intended);
+      co_await timer.async_wait(use_nothrow_awaitable);
+    }
+
+    pending.intended.push_back(intended);
+
+    auto [e, n] = co_await async_write(socket, buffer(request), use_nothrow_awaitable);
+    if (e)
+    {
+      // The receiver may already have given up and counted this request.
+      if (pending.intended.empty())
+        r.dropped += requests_from(s, intended + s.interval);
+      else
+      {
+        pending.intended.pop_back();
+        r.dropped += requests_from(s, intended);
+      }
+      break;
+    }
+  }
+
+  pending.sending = false;
+  if (pending.intended.empty())
+    socket.cancel();
+}
+
+awaitable<void> receive_responses(tcp::socket& socket,
+    std::size_t message_size, in_flight& pending, results& r)
+{
+  std::vector<char> response(message_size);
+
+  while (pending.sending || !pending.intended.empty())
+  {
+    auto result = co_await (
+        async_read(socket, buffer(response), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result.index() == 1)
+    {
+      r.errors += pending.intended.size(); // timed out
+      pending.intended.clear();
+      break;
+    }
+
+    auto [e, n] = std::get<0>(result);
+    if (e)
+    {
+      if (e != asio::error::operation_aborted)
+        r.errors += pending.intended.size();
+      pending.intended.clear();
+      break;
+    }
+
+    record_latency(r, pending.intended.front());
+    pending.intended.pop_front();
+    r.bytes += 2 * n;
+  }
+
+  socket.close();
+}
+
+// Keeps one connection open and pipelines requests on it.
+awaitable<void> run_keepalive(tcp::endpoint target,
+    std::size_t message_size, schedule s, results& r)
+{
+  tcp::socket socket(co_await this_coro::executor);
+
+  auto [e] = co_await socket.async_connect(target, use_nothrow_awaitable);
+  if (e)
+  {
+    ++r.errors;
+    r.dropped += requests_from(s, s.first);
+    co_return;
+  }
+
+  std::error_code ec;
+  socket.set_option(tcp::no_delay(true), ec);
+
+  in_flight pending;
+  co_await (
+      send_requests(socket, message_size, s, pending, r) &&
+      receive_responses(socket, message_size, pending, r)
+    );
+}
+
+// Opens a new connection for every request, so that the accept and connect
+// paths are exercised as much as the transfer path. Each lane handles one
+// request at a time, and a lane that falls behind charges the delay to the
+// requests that were waiting.
+awaitable<void> run_churn(tcp::endpoint target,
+    std::size_t message_size, schedule s, results& r)
+{
+  auto ex = co_await this_coro::executor;
+  asio::steady_timer timer(ex);
+  std::vector<char> request(message_size, 'x');
+  std::vector<char> response(message_size);
+
+  for (auto intended = s.first; intended < s.end; intended += s.interval)
+  {
+    if (steady_clock::now() < intended)
+    {
+      timer.expires_at(intended);
+      co_await timer.async_wait(use_nothrow_awaitable);
+    }
+
+    tcp::socket socket(ex);
+
+    auto [e1] = co_await socket.async_connect(target, use_nothrow_awaitable);
+    if (e1)
+    {
+      ++r.errors;
+      continue;
+    }
+
+    std::error_code ec;
+    socket.set_option(tcp::no_delay(true), ec);
+
+    auto [e2, n2] = co_await async_write(socket, buffer(request), use_nothrow_awaitable);
+    if (e2)
+    {
+      ++r.errors;
+      continue;
+    }
+
+    auto result = co_await (
+        async_read(socket, buffer(response), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result.index() == 1)
+    {
+      ++r.errors; // timed out
+      continue;
+    }
+
+    auto [e3, n3] = std::get<0>(result);
+    if (e3)
+    {
+      ++r.errors;
+      continue;
+    }
+
+    record_latency(r, intended);
+    r.bytes += n2 + n3;
+  }
+}
+
+double to_us(std::uint64_t ns)
+{
+  return ns / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 7 && argc != 8)
+    {
+      std::cerr << "Usage: load_generator";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " <connections> <requests_per_second> <message_size> <seconds>";
+      std::cerr << " [keepalive|churn]\n";
+      return 1;
+    }
+
+    std::size_t connections = std::stoul(argv[3]);
+    double rate = std::stod(argv[4]);
+    std::size_t message_size = std::stoul(argv[5]);
+    std::chrono::seconds duration(std::stoul(argv[6]));
+    std::string mode = argc == 8 ? argv[7] : "keepalive";
+
+    if (connections == 0 || rate <= 0 || (mode != "keepalive" && mode != "churn"))
+    {
+      std::cerr << "Invalid arguments\n";
+      return 1;
+    }
+
+    asio::io_context ctx(1);
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2]
+        );
+
+    results r;
+
+    // Each connection sends at rate / connections, and the connections are
+    // staggered so that the combined arrivals are evenly spaced.
+    auto spacing = std::chrono::duration_cast<steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / rate));
+    auto start = steady_clock::now() + 100ms;
+
+    for (std::size_t i = 0; i < connections; ++i)
+    {
+      auto offset = static_cast<steady_clock::rep>(i);
+      auto lanes = static_cast<steady_clock::rep>(connections);
+      schedule s{start + offset * spacing, lanes * spacing, start + duration};
+      if (mode == "churn")
+        co_spawn(ctx, run_churn(target_endpoint, message_size, s, r), detached);
+      else
+        co_spawn(ctx, run_keepalive(target_endpoint, message_size, s, r), detached);
+    }
+
+    ctx.run();
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    const histogram& h = r.latencies;
+
+    std::cout << "requests=" << h.total();
+    std::cout << " errors=" << r.errors;
+    std::cout << " dropped=" << r.dropped;
+    std::cout << " bytes=" << r.bytes;
+    std::cout << " seconds=" << seconds;
+    std::cout << " requests_per_second=" << h.total() / seconds;
+    std::cout << " mb_per_second=" << r.bytes / seconds / 1e6;
+    std::cout << " p50_us=" << to_us(h.value_at_percentile(50));
+    std::cout << " p90_us=" << to_us(h.value_at_percentile(90));
+    std::cout << " p99_us=" << to_us(h.value_at_percentile(99));
+    std::cout << " p999_us=" << to_us(h.value_at_percentile(99.9));
+    std::cout << " p9999_us=" << to_us(h.value_at_percentile(99.99));
+    std::cout << " max_us=" << to_us(h.max());
+    std::cout << "\n";
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+    return 1;
+  }
+}
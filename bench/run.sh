@@ -0,0 +1,109 @@
+#!/bin/bash
+#
+# Usage: run.sh <variant>...
+#
+# Runs each proxy variant between load_client and echo_server on loopback and
+# prints one line of results per variant. The load can be changed with the
+# CONNECTIONS, MESSAGE_SIZE and DURATION environment variables. Setting RATE
+# switches to the open-loop load_generator at that many requests per second,
+# and MODE=churn makes it open a new connection for every request.
+
+set -eu
+
+cd "$(dirname "$0")"
+
+CONNECTIONS=${CONNECTIONS:-64}
+MESSAGE_SIZE=${MESSAGE_SIZE:-1024}
+DURATION=${DURATION:-10}
+ECHO_PORT=${ECHO_PORT:-55555}
+PROXY_PORT=${PROXY_PORT:-55556}
+CLOCK_TICKS=$(getconf CLK_TCK)
+
+wait_for_port()
+{
+  for _ in $(seq 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+      return 0
+    fi
+    sleep 0.1
+  done
+  return 1
+}
+
+cpu_ticks()
+{
+  # utime + stime, in clock ticks.
+  awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+allocations()
+{
+  kill -USR2 "$1"
+  sleep 0.2
+  awk '/^allocations / { n = $2 } END { print n + 0 }' "$2"
+}
+
+field()
+{
+  tr ' ' '\n' <<< "$1" | awk -F= -v key="$2" '$1 == key { print $2 }'
+}
+
+bin/echo_server 127.0.0.1 "$ECHO_PORT" &
+ECHO_PID=$!
+trap 'kill $ECHO_PID 2>/dev/null || true' EXIT
+wait_for_port "$ECHO_PORT"
+
+LOG=$(mktemp)
+
+printf "%-24s %12s %10s %10s %10s %10s %10s %12s\n" \
+  variant "requests/s" "MB/s" "p50_us" "p99_us" "p999_us" "cpu_s/GB" "allocs/req"
+
+for variant in "$@"; do
+  : > "$LOG"
+  "$variant" 127.0.0.1 "$PROXY_PORT" 127.0.0.1 "$ECHO_PORT" > /dev/null 2> "$LOG" &
+  PROXY_PID=$!
+
+  if ! wait_for_port "$PROXY_PORT"; then
+    echo "$(basename "$variant"): did not start" >&2
+    kill "$PROXY_PID" 2>/dev/null || true
+    continue
+  fi
+  sleep 0.2
+
+  ALLOCATIONS_BEFORE=$(allocations "$PROXY_PID" "$LOG")
+  TICKS_BEFORE=$(cpu_ticks "$PROXY_PID")
+
+  if [ -n "${RATE:-}" ]; then
+    RESULT=$(bin/load_generator 127.0.0.1 "$PROXY_PORT" \
+      "$CONNECTIONS" "$RATE" "$MESSAGE_SIZE" "$DURATION" "${MODE:-keepalive}")
+  else
+    RESULT=$(bin/load_client 127.0.0.1 "$PROXY_PORT" \
+      "$CONNECTIONS" "$MESSAGE_SIZE" "$DURATION")
+  fi
+
+  TICKS_AFTER=$(cpu_ticks "$PROXY_PID")
+  ALLOCATIONS_AFTER=$(allocations "$PROXY_PID" "$LOG")
+
+  kill "$PROXY_PID" 2>/dev/null || true
+  wait "$PROXY_PID" 2>/dev/null || true
+
+  awk -v name="$(basename "$variant")" \
+      -v requests="$(field "$RESULT" requests)" \
+      -v bytes="$(field "$RESULT" bytes)" \
+      -v rps="$(field "$RESULT" requests_per_second)" \
+      -v mbps="$(field "$RESULT" mb_per_second)" \
+      -v p50="$(field "$RESULT" p50_us)" \
+      -v p99="$(field "$RESULT" p99_us)" \
+      -v p999="$(field "$RESULT" p999_us)" \
+      -v ticks="$((TICKS_AFTER - TICKS_BEFORE))" \
+      -v hz="$CLOCK_TICKS" \
+      -v allocs="$((ALLOCATIONS_AFTER - ALLOCATIONS_BEFORE))" \
+      'BEGIN {
+        cpu_per_gb = bytes > 0 ? (ticks / hz) / (bytes / 1e9) : 0
+        per_request = requests > 0 ? allocs / requests : 0
+        printf "%-24s %12.0f %10.1f %10.1f %10.1f %10.1f %10.2f %12.2f\n",
+          name, rps, mbps, p50, p99, p999, cpu_per_gb, per_request
+      }'
+done
+
+rm -f "$LOG"
@@ -0,0 +1,270 @@
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <memory>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> buffered_transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+#if defined(__linux__)
+
+constexpr std::size_t splice_chunk_size = 65536;
+
+class splice_pipe
+{
+public:
+  splice_pipe()
+  {
+    if (::pipe2(fds_, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      fds_[0] = fds_[1] = -1;
+    }
+  }
+
+  splice_pipe(const splice_pipe&) = delete;
+  splice_pipe& operator=(const splice_pipe&) = delete;
+
+  ~splice_pipe()
+  {
+    if (is_open())
+    {
+      ::close(fds_[0]);
+      ::close(fds_[1]);
+    }
+  }
+
+  bool is_open() const
+  {
+    return fds_[0] != -1;
+  }
+
+  int read_end() const
+  {
+    return fds_[0];
+  }
+
+  int write_end() const
+  {
+    return fds_[1];
+  }
+
+private:
+  int fds_[2];
+};
+
+// Moves data from one socket to the other through a kernel pipe, so that the
+// bytes never enter user space. Asio is used only to wait for readiness.
+// Returns false, having moved no data, if splice cannot be used.
+awaitable<bool> splice_transfer(tcp::socket& from, tcp::socket& to)
+{
+  splice_pipe pipe;
+  if (!pipe.is_open())
+    co_return false;
+
+  std::error_code ec;
+  from.native_non_blocking(true, ec);
+  if (!ec)
+    to.native_non_blocking(true, ec);
+  if (ec)
+    co_return false;
+
+  bool first_splice = true;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_wait(tcp::socket::wait_read, use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return true; // timed out
+
+    auto [e1] = std::get<0>(result1);
+    if (e1)
+      co_return true;
+
+    ssize_t n1 = ::splice(from.native_handle(), nullptr,
+        pipe.write_end(), nullptr, splice_chunk_size,
+        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (n1 < 0 && (errno == EINVAL || errno == ENOSYS) && first_splice)
+      co_return false; // not supported for this socket
+
+    first_splice = false;
+
+    if (n1 < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      continue;
+
+    if (n1 <= 0)
+      co_return true; // eof or error
+
+    auto write_deadline = steady_clock::now() + 1s;
+    std::size_t pending = static_cast<std::size_t>(n1);
+    while (pending > 0)
+    {
+      ssize_t n2 = ::splice(pipe.read_end(), nullptr,
+          to.native_handle(), nullptr, pending,
+          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+      if (n2 > 0)
+      {
+        pending -= static_cast<std::size_t>(n2);
+        continue;
+      }
+
+      if (n2 < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        co_return true;
+
+      auto now = steady_clock::now();
+      if (now >= write_deadline)
+        co_return true; // timed out
+
+      auto result2 = co_await (
+          to.async_wait(tcp::socket::wait_write, use_nothrow_awaitable) ||
+          timeout(write_deadline - now)
+        );
+
+      if (result2.index() == 1)
+        co_return true; // timed out
+
+      auto [e2] = std::get<0>(result2);
+      if (e2)
+        co_return true;
+    }
+  }
+}
+
+#endif // defined(__linux__)
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+#if defined(__linux__)
+  if (co_await splice_transfer(from, to))
+    co_return;
+#endif
+
+  co_await buffered_transfer(from, to);
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,216 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target), detached);
+  }
+}
+
+#if defined(SO_REUSEPORT)
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+tcp::acceptor make_acceptor(asio::io_context& ctx, tcp::endpoint listen_endpoint)
+{
+  tcp::acceptor acceptor(ctx);
+  acceptor.open(listen_endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+  acceptor.set_option(reuse_port(true));
+#endif
+  acceptor.bind(listen_endpoint);
+  acceptor.listen();
+  return acceptor;
+}
+
+void pin_to_cpu(std::size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % CPU_SETSIZE, &cpus);
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void)cpu;
+#endif
+}
+
+// Each shard owns an io_context that is run by exactly one thread. Sessions
+// are spawned on the executor of the acceptor that accepted them, so all of a
+// session's work stays on that thread and needs no synchronisation.
+struct shard
+{
+  shard(tcp::endpoint listen_endpoint, tcp::endpoint target_endpoint)
+    : acceptor(make_acceptor(ctx, listen_endpoint))
+  {
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+  }
+
+  void run(std::size_t cpu)
+  {
+    pin_to_cpu(cpu);
+    ctx.run();
+  }
+
+  asio::io_context ctx{1};
+  tcp::acceptor acceptor;
+};
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5 && argc != 6)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<threads>]\n";
+      return 1;
+    }
+
+    std::size_t num_shards = std::thread::hardware_concurrency();
+    if (argc == 6)
+      num_shards = std::stoul(argv[5]);
+#if !defined(SO_REUSEPORT)
+    num_shards = 1;
+#endif
+    num_shards = std::max<std::size_t>(num_shards, 1);
+
+    asio::io_context resolver_ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(resolver_ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(resolver_ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    std::vector<std::unique_ptr<shard>> shards;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      shards.push_back(
+          std::make_unique<shard>(
+            listen_endpoint,
+            target_endpoint
+          )
+        );
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      threads.emplace_back(
+          [&s = *shards[i], i]
+          {
+            try
+            {
+              s.run(i);
+            }
+            catch (std::exception& e)
+            {
+              std::cerr << "Exception: " << e.what() << "\n";
+            }
+          }
+        );
+    }
+
+    for (auto& t : threads)
+      t.join();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,281 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+using endpoint_set = std::shared_ptr<const std::vector<tcp::endpoint>>;
+
+awaitable<void> proxy(tcp::socket client, endpoint_set targets)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e, endpoint] = co_await asio::async_connect(server, *targets, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, const endpoint_set& targets)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), targets), detached);
+  }
+}
+
+#if defined(SO_REUSEPORT)
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+tcp::acceptor make_acceptor(asio::io_context& ctx, tcp::endpoint listen_endpoint)
+{
+  tcp::acceptor acceptor(ctx);
+  acceptor.open(listen_endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+  acceptor.set_option(reuse_port(true));
+#endif
+  acceptor.bind(listen_endpoint);
+  acceptor.listen();
+  return acceptor;
+}
+
+void pin_to_cpu(std::size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % CPU_SETSIZE, &cpus);
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void)cpu;
+#endif
+}
+
+// Each shard owns an io_context that is run by exactly one thread. Sessions
+// are spawned on the executor of the acceptor that accepted them, so all of a
+// session's work stays on that thread and needs no synchronisation.
+//
+// The shard also keeps its own copy of the backend endpoints. A new set is
+// swapped in by a handler posted to the shard, so sessions read the current
+// set without locks or atomics. Accepting starts once the first set arrives.
+struct shard
+{
+  explicit shard(tcp::endpoint listen_endpoint)
+    : acceptor(make_acceptor(ctx, listen_endpoint))
+  {
+  }
+
+  void update_targets(std::vector<tcp::endpoint> endpoints)
+  {
+    asio::post(ctx,
+        [this, endpoints = std::move(endpoints)]() mutable
+        {
+          targets = std::make_shared<const std::vector<tcp::endpoint>>(
+              std::move(endpoints));
+
+          if (!listening)
+          {
+            listening = true;
+            co_spawn(ctx, listen(acceptor, targets), detached);
+          }
+        }
+      );
+  }
+
+  void run(std::size_t cpu)
+  {
+    pin_to_cpu(cpu);
+    ctx.run();
+  }
+
+  asio::io_context ctx{1};
+  asio::executor_work_guard<asio::io_context::executor_type> work{ctx.get_executor()};
+  tcp::acceptor acceptor;
+  endpoint_set targets;
+  bool listening = false;
+};
+
+// Resolves the backend asynchronously and publishes the endpoints to every
+// shard whenever they change. getaddrinfo does not report record TTLs, so the
+// addresses are refreshed at a fixed interval. If resolution fails, the
+// shards carry on with the last good set.
+awaitable<void> refresh_targets(std::string host, std::string service,
+    steady_clock::duration interval, std::vector<std::unique_ptr<shard>>& shards)
+{
+  tcp::resolver resolver(co_await this_coro::executor);
+  asio::steady_timer timer(co_await this_coro::executor);
+  std::vector<tcp::endpoint> current;
+
+  for (;;)
+  {
+    auto [e, results] = co_await resolver.async_resolve(host, service, use_nothrow_awaitable);
+    if (!e)
+    {
+      std::vector<tcp::endpoint> endpoints;
+      for (auto& entry : results)
+        endpoints.push_back(entry.endpoint());
+
+      if (endpoints != current)
+      {
+        current = endpoints;
+        for (auto& s : shards)
+          s->update_targets(current);
+      }
+    }
+    else
+    {
+      std::cerr << "Resolve failed: " << e.message() << "\n";
+    }
+
+    timer.expires_after(current.empty() ? 1s : interval);
+    co_await timer.async_wait(use_nothrow_awaitable);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc < 5 || argc > 7)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<threads> [<refresh_seconds>]]\n";
+      return 1;
+    }
+
+    std::size_t num_shards = std::thread::hardware_concurrency();
+    if (argc >= 6)
+      num_shards = std::stoul(argv[5]);
+#if !defined(SO_REUSEPORT)
+    num_shards = 1;
+#endif
+    num_shards = std::max<std::size_t>(num_shards, 1);
+
+    std::chrono::seconds refresh_interval(30);
+    if (argc == 7)
+      refresh_interval = std::chrono::seconds(std::stoul(argv[6]));
+
+    asio::io_context resolver_ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(resolver_ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    std::vector<std::unique_ptr<shard>> shards;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      shards.push_back(
+          std::make_unique<shard>(
+            listen_endpoint
+          )
+        );
+    }
+
+    co_spawn(resolver_ctx,
+        refresh_targets(argv[3], argv[4], refresh_interval, shards),
+        detached);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      threads.emplace_back(
+          [&s = *shards[i], i]
+          {
+            try
+            {
+              s.run(i);
+            }
+            catch (std::exception& e)
+            {
+              std::cerr << "Exception: " << e.what() << "\n";
+            }
+          }
+        );
+    }
+
+    resolver_ctx.run();
+
+    for (auto& t : threads)
+      t.join();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
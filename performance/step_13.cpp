@@ -0,0 +1,265 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <netinet/tcp.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+#if defined(TCP_FASTOPEN)
+using tcp_fastopen = asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>;
+#endif
+
+#if defined(TCP_FASTOPEN_CONNECT)
+using tcp_fastopen_connect = asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>;
+#endif
+
+#if defined(TCP_DEFER_ACCEPT)
+using tcp_defer_accept = asio::detail::socket_option::integer<IPPROTO_TCP, TCP_DEFER_ACCEPT>;
+#endif
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+// Reads whatever the client sends while the backend connection is still being
+// established. Gives up, without consuming anything, as soon as the connect
+// completes, so that protocols in which the server speaks first are not held
+// up waiting for the client.
+awaitable<std::size_t> read_early_data(tcp::socket& client,
+    asio::mutable_buffer data, asio::steady_timer& connected)
+{
+  auto result = co_await (
+      client.async_read_some(data, use_nothrow_awaitable) ||
+      connected.async_wait(use_nothrow_awaitable)
+    );
+
+  if (result.index() == 0)
+  {
+    auto [e, n] = std::get<0>(result);
+    if (!e)
+      co_return n;
+  }
+
+  co_return 0;
+}
+
+awaitable<std::error_code> connect_to_server(tcp::socket& server,
+    tcp::endpoint target, asio::steady_timer& connected)
+{
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  connected.cancel();
+  co_return e;
+}
+
+// Opens the backend socket with TCP_FASTOPEN_CONNECT where available. The
+// connect then completes at once, and the SYN goes out with the first write,
+// carrying that write's data if the kernel holds a cookie for the backend.
+// This is only worthwhile when the client's first bytes are already in hand,
+// since otherwise the backend would not see a SYN until the client speaks.
+void open_for_fast_open(tcp::socket& server, const tcp::endpoint& target)
+{
+  std::error_code ec;
+  server.open(target.protocol(), ec);
+#if defined(TCP_FASTOPEN_CONNECT)
+  if (!ec)
+    server.set_option(tcp_fastopen_connect(true), ec);
+#endif
+}
+
+// Writes the client's first bytes to the backend. With TCP_FASTOPEN_CONNECT it
+// is this write that starts the connect. If the kernel holds no Fast Open
+// cookie for the backend, the SYN goes out without data and the write fails
+// with EINPROGRESS, so wait for the connection to be established and then
+// write the bytes again.
+awaitable<std::error_code> write_early_data(tcp::socket& server, asio::const_buffer data)
+{
+  std::error_code e;
+  server.non_blocking(true, e);
+  if (e)
+    co_return e;
+
+  std::size_t n = server.write_some(data, e);
+  if (e == asio::error::in_progress || e == asio::error::would_block)
+    std::tie(e) = co_await server.async_wait(tcp::socket::wait_write, use_nothrow_awaitable);
+
+  if (!e)
+    std::tie(e, n) = co_await async_write(server, data + n, use_nothrow_awaitable);
+
+  co_return e;
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+  asio::steady_timer connected(client.get_executor(), steady_clock::time_point::max());
+  std::array<char, 1024> early_data;
+  std::size_t n = 0;
+  std::error_code e;
+
+  // With TCP_DEFER_ACCEPT the client's first bytes have usually arrived by
+  // the time the connection is accepted, so try to pick them up at once.
+  client.non_blocking(true, e);
+  if (!e)
+    n = client.read_some(buffer(early_data), e);
+
+  if (n > 0)
+  {
+    open_for_fast_open(server, target);
+    std::tie(e) = co_await server.async_connect(target, use_nothrow_awaitable);
+  }
+  else
+  {
+    std::tie(n, e) = co_await (
+        read_early_data(client, buffer(early_data), connected) &&
+        connect_to_server(server, target, connected)
+      );
+  }
+
+  if (!e)
+  {
+    if (n > 0)
+    {
+      auto result = co_await (
+          write_early_data(server, buffer(early_data, n)) ||
+          timeout(1s)
+        );
+
+      if (result.index() == 1)
+        co_return; // timed out
+
+      if (std::get<0>(result))
+        co_return;
+    }
+
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target), detached);
+  }
+}
+
+// Creates the listening socket with TCP Fast Open enabled, and with
+// TCP_DEFER_ACCEPT so that a connection is only reported as accepted once the
+// client has sent some data.
+tcp::acceptor make_acceptor(asio::io_context& ctx, tcp::endpoint listen_endpoint)
+{
+  tcp::acceptor acceptor(ctx);
+  acceptor.open(listen_endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+  acceptor.bind(listen_endpoint);
+
+  std::error_code ec;
+#if defined(TCP_FASTOPEN)
+  acceptor.set_option(tcp_fastopen(256), ec);
+#endif
+#if defined(TCP_DEFER_ACCEPT)
+  acceptor.set_option(tcp_defer_accept(5), ec);
+#endif
+
+  acceptor.listen();
+  return acceptor;
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor = make_acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
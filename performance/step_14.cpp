@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <memory>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+constexpr std::size_t max_accept_batch = 64;
+
+struct accept_statistics
+{
+  std::size_t wakeups = 0;
+  std::size_t accepted = 0;
+  std::size_t largest_batch = 0;
+  std::array<std::size_t, 8> batch_sizes{}; // 0, 1, 2-3, 4-7, ..., 64+
+
+  void record(std::size_t batch)
+  {
+    ++wakeups;
+    accepted += batch;
+    largest_batch = std::max(largest_batch, batch);
+
+    std::size_t bucket = 0;
+    while (batch > 0 && bucket + 1 < batch_sizes.size())
+    {
+      batch >>= 1;
+      ++bucket;
+    }
+    ++batch_sizes[bucket];
+  }
+};
+
+// Accepts one pending connection without blocking. On Linux, accept4 hands
+// back a socket that is already non-blocking and close-on-exec.
+tcp::socket accept_now(tcp::acceptor& acceptor,
+    const tcp& protocol, std::error_code& ec)
+{
+#if defined(__linux__)
+  tcp::socket client(acceptor.get_executor());
+  int fd = ::accept4(acceptor.native_handle(),
+      nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0)
+  {
+    ec.assign(errno, asio::error::get_system_category());
+    return client;
+  }
+
+  client.assign(protocol, fd, ec);
+  if (ec)
+    ::close(fd);
+  return client;
+#else
+  (void)protocol;
+  return acceptor.accept(ec);
+#endif
+}
+
+// Waits for the listening socket to become readable, then drains up to
+// max_accept_batch connections from the backlog before waiting again.
+awaitable<void> listen(tcp::acceptor& acceptor,
+    tcp::endpoint target, accept_statistics& stats)
+{
+  auto ex = acceptor.get_executor();
+  auto protocol = acceptor.local_endpoint().protocol();
+  acceptor.non_blocking(true);
+
+  for (;;)
+  {
+    auto [e] = co_await acceptor.async_wait(tcp::acceptor::wait_read, use_nothrow_awaitable);
+    if (e)
+      break;
+
+    std::size_t batch = 0;
+    while (batch < max_accept_batch)
+    {
+      std::error_code ec;
+      tcp::socket client = accept_now(acceptor, protocol, ec);
+      if (ec == asio::error::would_block || ec == asio::error::try_again)
+        break;
+      if (ec == asio::error::connection_aborted)
+        continue;
+      if (ec)
+        co_return;
+
+      ++batch;
+      co_spawn(ex, proxy(std::move(client), target), detached);
+    }
+
+    stats.record(batch);
+  }
+}
+
+awaitable<void> report_statistics(accept_statistics& stats)
+{
+  asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+  for (;;)
+  {
+    auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    std::cout << "accept: wakeups=" << stats.wakeups;
+    std::cout << " accepted=" << stats.accepted;
+    std::cout << " per_wakeup=" << (stats.wakeups ? double(stats.accepted) / stats.wakeups : 0.0);
+    std::cout << " largest_batch=" << stats.largest_batch;
+    std::cout << " batch_sizes=";
+    for (std::size_t i = 0; i < stats.batch_sizes.size(); ++i)
+      std::cout << (i ? "," : "") << stats.batch_sizes[i];
+    std::cout << "\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    accept_statistics stats;
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, stats), detached);
+    co_spawn(ctx, report_statistics(stats), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
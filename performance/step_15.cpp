@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+// Counts live sessions per source address. The table uses open addressing
+// with linear probing over a flat array, and backward-shift deletion so that
+// no tombstones build up as clients come and go. IPv4 addresses are stored
+// in their IPv4-mapped IPv6 form, giving every slot the same fixed size.
+class source_table
+{
+public:
+  // Adds a session for the address, unless it already has limit sessions.
+  bool try_increment(const asio::ip::address& address, std::size_t limit)
+  {
+    key_type key = make_key(address);
+    std::size_t i = find(key);
+    if (slots_[i].count != 0)
+    {
+      if (slots_[i].count >= limit)
+        return false;
+      ++slots_[i].count;
+      return true;
+    }
+
+    if (limit == 0)
+      return false;
+
+    if ((size_ + 1) * 2 > slots_.size())
+    {
+      grow();
+      i = find(key);
+    }
+
+    slots_[i].key = key;
+    slots_[i].count = 1;
+    ++size_;
+    return true;
+  }
+
+  void decrement(const asio::ip::address& address)
+  {
+    std::size_t i = find(make_key(address));
+    if (slots_[i].count != 0 && --slots_[i].count == 0)
+      erase_at(i);
+  }
+
+private:
+  using key_type = asio::ip::address_v6::bytes_type;
+
+  struct slot
+  {
+    key_type key{};
+    std::uint32_t count = 0; // zero marks an empty slot
+  };
+
+  static key_type make_key(const asio::ip::address& address)
+  {
+    if (address.is_v4())
+      return asio::ip::make_address_v6(asio::ip::v4_mapped, address.to_v4()).to_bytes();
+    return address.to_v6().to_bytes();
+  }
+
+  static std::size_t hash(const key_type& key)
+  {
+    std::uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (unsigned char b : key)
+      h = (h ^ b) * 1099511628211ull;
+    return static_cast<std::size_t>(h);
+  }
+
+  // Returns the slot holding the key, or the empty slot where it belongs.
+  std::size_t find(const key_type& key) const
+  {
+    std::size_t mask = slots_.size() - 1;
+    std::size_t i = hash(key) & mask;
+    while (slots_[i].count != 0 && slots_[i].key != key)
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  void erase_at(std::size_t i)
+  {
+    std::size_t mask = slots_.size() - 1;
+    for (std::size_t j = (i + 1) & mask; slots_[j].count != 0; j = (j + 1) & mask)
+    {
+      // Leave the entry where it is if its home slot lies cyclically in (i, j].
+      std::size_t home = hash(slots_[j].key) & mask;
+      bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+      if (!stays)
+      {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+
+    slots_[i] = slot{};
+    --size_;
+  }
+
+  void grow()
+  {
+    std::vector<slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    for (const slot& s : old)
+      if (s.count != 0)
+        slots_[find(s.key)] = s;
+  }
+
+  std::vector<slot> slots_ = std::vector<slot>(64);
+  std::size_t size_ = 0;
+};
+
+// Limits the number of concurrent sessions, overall and per source address.
+// When the overall limit is reached the listener stops accepting, leaving new
+// connections in the kernel's backlog, until a session finishes. Tickets may
+// be released while the io_context destroys its suspended sessions, so this
+// object must outlive the io_context and therefore holds no I/O objects.
+class admission_control
+{
+public:
+  class ticket
+  {
+  public:
+    ticket(admission_control& owner, asio::ip::address source)
+      : owner_(&owner),
+        source_(source)
+    {
+    }
+
+    ticket(ticket&& other) noexcept
+      : owner_(std::exchange(other.owner_, nullptr)),
+        source_(other.source_)
+    {
+    }
+
+    ticket& operator=(ticket&&) = delete;
+
+    ~ticket()
+    {
+      if (owner_)
+        owner_->release(source_);
+    }
+
+  private:
+    admission_control* owner_;
+    asio::ip::address source_;
+  };
+
+  admission_control(std::size_t max_sessions, std::size_t max_per_source)
+    : max_sessions_(max_sessions),
+      max_per_source_(max_per_source)
+  {
+  }
+
+  // The timer lives in the waiting coroutine's frame, and the guard forgets
+  // it again however that frame is left.
+  awaitable<void> wait_for_capacity()
+  {
+    if (active_ < max_sessions_)
+      co_return;
+
+    asio::steady_timer capacity_available(
+        co_await this_coro::executor, steady_clock::time_point::max());
+
+    capacity_available_ = &capacity_available;
+    struct waiter_guard
+    {
+      asio::steady_timer*& waiter;
+      ~waiter_guard() { waiter = nullptr; }
+    } guard{capacity_available_};
+
+    while (active_ >= max_sessions_)
+      co_await capacity_available.async_wait(use_nothrow_awaitable);
+  }
+
+  bool try_admit(const asio::ip::address& source)
+  {
+    if (active_ >= max_sessions_)
+      return false;
+    if (!sources_.try_increment(source, max_per_source_))
+      return false;
+    ++active_;
+    return true;
+  }
+
+private:
+  void release(const asio::ip::address& source)
+  {
+    sources_.decrement(source);
+    if (active_-- == max_sessions_ && capacity_available_)
+      capacity_available_->cancel();
+  }
+
+  std::size_t max_sessions_;
+  std::size_t max_per_source_;
+  std::size_t active_ = 0;
+  source_table sources_;
+  asio::steady_timer* capacity_available_ = nullptr;
+};
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target,
+    admission_control::ticket)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+constexpr steady_clock::duration accept_backoff_min = 10ms;
+constexpr steady_clock::duration accept_backoff_max = 1s;
+
+bool is_resource_exhausted(const std::error_code& e)
+{
+  return e == asio::error::no_descriptors // EMFILE
+    || e == std::errc::too_many_files_open_in_system
+    || e == asio::error::no_buffer_space
+    || e == asio::error::no_memory;
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor,
+    tcp::endpoint target, admission_control& admission)
+{
+  auto backoff = accept_backoff_min;
+
+  for (;;)
+  {
+    co_await admission.wait_for_capacity();
+
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e == asio::error::connection_aborted)
+      continue;
+
+    if (is_resource_exhausted(e))
+    {
+      // The pending connection stays in the backlog. Retry once some
+      // descriptors or memory have been given back.
+      co_await timeout(backoff);
+      backoff = std::min(backoff * 2, accept_backoff_max);
+      continue;
+    }
+
+    if (e)
+      break;
+
+    backoff = accept_backoff_min;
+
+    std::error_code ec;
+    auto source = client.remote_endpoint(ec).address();
+    if (ec || !admission.try_admit(source))
+      continue; // the connection is closed when client goes out of scope
+
+    auto ex = client.get_executor();
+    co_spawn(ex,
+        proxy(std::move(client), target,
+          admission_control::ticket(admission, source)),
+        detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5 && argc != 7)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<max_sessions> <max_sessions_per_source>]\n";
+      return 1;
+    }
+
+    std::size_t max_sessions = argc == 7 ? std::stoul(argv[5]) : 10000;
+    std::size_t max_per_source = argc == 7 ? std::stoul(argv[6]) : 100;
+
+    admission_control admission(max_sessions, max_per_source);
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, admission), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,476 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+constexpr std::size_t cache_line_size = 64;
+
+// A counter that is written only by the thread that owns it. An update is a
+// relaxed load and store rather than an atomic read-modify-write, so it costs
+// no more than a plain increment, yet the stats listener can still read the
+// value from another thread without a data race.
+class counter
+{
+public:
+  void add(std::uint64_t n = 1)
+  {
+    value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t load() const
+  {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::uint64_t> value_{0};
+};
+
+// A single-writer histogram with power-of-two buckets. Bucket i counts the
+// values whose bit width is i, that is, values no greater than 2^i - 1. The
+// last bucket also takes everything larger.
+class histogram
+{
+public:
+  static constexpr std::size_t num_buckets = 40;
+
+  void observe(std::uint64_t value)
+  {
+    buckets_[std::min<std::size_t>(std::bit_width(value), num_buckets - 1)].add();
+    sum_.add(value);
+  }
+
+  std::uint64_t bucket(std::size_t i) const
+  {
+    return buckets_[i].load();
+  }
+
+  std::uint64_t sum() const
+  {
+    return sum_.load();
+  }
+
+  static std::uint64_t upper_bound(std::size_t i)
+  {
+    return (std::uint64_t(1) << i) - 1;
+  }
+
+private:
+  std::array<counter, num_buckets> buckets_;
+  counter sum_;
+};
+
+// Everything one shard records. Each shard's metrics start on their own cache
+// line so that no two threads ever write to the same line.
+struct alignas(cache_line_size) shard_metrics
+{
+  counter sessions;
+  counter sessions_finished;
+  counter connect_failures;
+  counter timeouts;
+  counter bytes_client_to_server;
+  counter bytes_server_to_client;
+  histogram connect_time_us;
+  histogram session_duration_ms;
+  histogram read_size_bytes;
+};
+
+using shard_metrics_list = std::vector<const shard_metrics*>;
+
+std::uint64_t total(const shard_metrics_list& shards, counter shard_metrics::* member)
+{
+  std::uint64_t sum = 0;
+  for (const shard_metrics* s : shards)
+    sum += (s->*member).load();
+  return sum;
+}
+
+void write_header(std::ostream& out, const char* name, const char* type, const char* help)
+{
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+}
+
+void write_counter(std::ostream& out, const shard_metrics_list& shards,
+    const char* name, const char* help, counter shard_metrics::* member)
+{
+  write_header(out, name, "counter", help);
+  out << name << " " << total(shards, member) << "\n";
+}
+
+void write_histogram(std::ostream& out, const shard_metrics_list& shards,
+    const char* name, const char* help, histogram shard_metrics::* member)
+{
+  write_header(out, name, "histogram", help);
+
+  std::uint64_t count = 0;
+  std::uint64_t sum = 0;
+  for (std::size_t i = 0; i < histogram::num_buckets; ++i)
+  {
+    for (const shard_metrics* s : shards)
+      count += (s->*member).bucket(i);
+
+    if (i + 1 < histogram::num_buckets)
+      out << name << "_bucket{le=\"" << histogram::upper_bound(i) << "\"} " << count << "\n";
+  }
+
+  for (const shard_metrics* s : shards)
+    sum += (s->*member).sum();
+
+  out << name << "_bucket{le=\"+Inf\"} " << count << "\n";
+  out << name << "_sum " << sum << "\n";
+  out << name << "_count " << count << "\n";
+}
+
+// Sums the per-shard metrics into the Prometheus text exposition format.
+std::string format_metrics(const shard_metrics_list& shards)
+{
+  std::ostringstream out;
+
+  write_counter(out, shards, "proxy_sessions_total",
+      "Sessions accepted.", &shard_metrics::sessions);
+
+  write_header(out, "proxy_active_sessions", "gauge", "Sessions in progress.");
+  // Finished sessions are loaded first, so that sessions ending between the
+  // two loads cannot make the difference negative.
+  std::uint64_t finished = total(shards, &shard_metrics::sessions_finished);
+  std::uint64_t started = total(shards, &shard_metrics::sessions);
+  out << "proxy_active_sessions "
+    << (started > finished ? started - finished : 0)
+    << "\n";
+
+  write_counter(out, shards, "proxy_connect_failures_total",
+      "Failed connections to the target.", &shard_metrics::connect_failures);
+
+  write_counter(out, shards, "proxy_timeouts_total",
+      "Reads and writes that timed out.", &shard_metrics::timeouts);
+
+  write_header(out, "proxy_bytes_total", "counter", "Bytes relayed.");
+  out << "proxy_bytes_total{direction=\"client_to_server\"} "
+    << total(shards, &shard_metrics::bytes_client_to_server) << "\n";
+  out << "proxy_bytes_total{direction=\"server_to_client\"} "
+    << total(shards, &shard_metrics::bytes_server_to_client) << "\n";
+
+  write_histogram(out, shards, "proxy_connect_time_microseconds",
+      "Time taken to connect to the target.", &shard_metrics::connect_time_us);
+
+  write_histogram(out, shards, "proxy_session_duration_milliseconds",
+      "Session lifetime.", &shard_metrics::session_duration_ms);
+
+  write_histogram(out, shards, "proxy_read_size_bytes",
+      "Bytes returned by each read.", &shard_metrics::read_size_bytes);
+
+  return out.str();
+}
+
+template <typename Duration>
+std::uint64_t elapsed(steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<Duration>(steady_clock::now() - start).count();
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to,
+    counter& bytes, shard_metrics& metrics)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+    {
+      metrics.timeouts.add();
+      co_return; // timed out
+    }
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    metrics.read_size_bytes.observe(n1);
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+    {
+      metrics.timeouts.add();
+      co_return; // timed out
+    }
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+
+    bytes.add(n2);
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target, shard_metrics& metrics)
+{
+  auto start = steady_clock::now();
+  metrics.sessions.add();
+
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (e)
+  {
+    metrics.connect_failures.add();
+  }
+  else
+  {
+    metrics.connect_time_us.observe(elapsed<std::chrono::microseconds>(start));
+
+    co_await (
+        transfer(client, server, metrics.bytes_client_to_server, metrics) ||
+        transfer(server, client, metrics.bytes_server_to_client, metrics)
+      );
+  }
+
+  metrics.session_duration_ms.observe(elapsed<std::chrono::milliseconds>(start));
+  metrics.sessions_finished.add();
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target, shard_metrics& metrics)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target, metrics), detached);
+  }
+}
+
+awaitable<void> serve_stats(tcp::socket socket, const shard_metrics_list& shards)
+{
+  std::string request;
+
+  auto result1 = co_await (
+      async_read_until(socket, asio::dynamic_buffer(request, 4096),
+        "\r\n\r\n", use_nothrow_awaitable) ||
+      timeout(5s)
+    );
+
+  if (result1.index() == 1)
+    co_return; // timed out
+
+  auto [e1, n1] = std::get<0>(result1);
+  if (e1)
+    co_return;
+
+  std::string response;
+  if (request.starts_with("GET /metrics ") || request.starts_with("GET / "))
+  {
+    std::string body = format_metrics(shards);
+    response = "HTTP/1.0 200 OK\r\n";
+    response += "Content-Type: text/plain; version=0.0.4\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+  }
+  else
+  {
+    response = "HTTP/1.0 404 Not Found\r\n";
+    response += "Content-Length: 0\r\n";
+    response += "Connection: close\r\n\r\n";
+  }
+
+  co_await (
+      async_write(socket, buffer(response), use_nothrow_awaitable) ||
+      timeout(5s)
+    );
+}
+
+awaitable<void> listen_stats(tcp::acceptor& acceptor, const shard_metrics_list& shards)
+{
+  for (;;)
+  {
+    auto [e, socket] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = socket.get_executor();
+    co_spawn(ex, serve_stats(std::move(socket), shards), detached);
+  }
+}
+
+#if defined(SO_REUSEPORT)
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+tcp::acceptor make_acceptor(asio::io_context& ctx, tcp::endpoint listen_endpoint)
+{
+  tcp::acceptor acceptor(ctx);
+  acceptor.open(listen_endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+  acceptor.set_option(reuse_port(true));
+#endif
+  acceptor.bind(listen_endpoint);
+  acceptor.listen();
+  return acceptor;
+}
+
+void pin_to_cpu(std::size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % CPU_SETSIZE, &cpus);
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void)cpu;
+#endif
+}
+
+// Each shard owns an io_context that is run by exactly one thread. Sessions
+// are spawned on the executor of the acceptor that accepted them, so all of a
+// session's work stays on that thread and needs no synchronisation.
+struct shard
+{
+  shard(tcp::endpoint listen_endpoint, tcp::endpoint target_endpoint)
+    : acceptor(make_acceptor(ctx, listen_endpoint))
+  {
+    co_spawn(ctx, listen(acceptor, target_endpoint, metrics), detached);
+  }
+
+  void run(std::size_t cpu)
+  {
+    pin_to_cpu(cpu);
+    ctx.run();
+  }
+
+  shard_metrics metrics;
+  asio::io_context ctx{1};
+  tcp::acceptor acceptor;
+};
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 6 && argc != 7)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " <stats_port> [<threads>]\n";
+      return 1;
+    }
+
+    std::size_t num_shards = std::thread::hardware_concurrency();
+    if (argc == 7)
+      num_shards = std::stoul(argv[6]);
+#if !defined(SO_REUSEPORT)
+    num_shards = 1;
+#endif
+    num_shards = std::max<std::size_t>(num_shards, 1);
+
+    asio::io_context stats_ctx(1);
+
+    auto listen_endpoint =
+      *tcp::resolver(stats_ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(stats_ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    std::vector<std::unique_ptr<shard>> shards;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      shards.push_back(
+          std::make_unique<shard>(
+            listen_endpoint,
+            target_endpoint
+          )
+        );
+    }
+
+    shard_metrics_list metrics;
+    for (auto& s : shards)
+      metrics.push_back(&s->metrics);
+
+    tcp::acceptor stats_acceptor(stats_ctx,
+        tcp::endpoint(listen_endpoint.endpoint().address(),
+          static_cast<unsigned short>(std::stoul(argv[5]))));
+
+    co_spawn(stats_ctx, listen_stats(stats_acceptor, metrics), detached);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      threads.emplace_back(
+          [&s = *shards[i], i]
+          {
+            try
+            {
+              s.run(i);
+            }
+            catch (std::exception& e)
+            {
+              std::cerr << "Exception: " << e.what() << "\n";
+            }
+          }
+        );
+    }
+
+    stats_ctx.run();
+
+    for (auto& t : threads)
+      t.join();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
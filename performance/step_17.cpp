@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+double seconds(steady_clock::duration d)
+{
+  return std::chrono::duration<double>(d).count();
+}
+
+// What one direction of a session is suspended on, and since when.
+struct direction_state
+{
+  const char* pending = nullptr; // a string literal naming the operation
+  bool can_stall = false;
+  steady_clock::time_point since;
+  std::uint64_t bytes = 0;
+
+  // A pending read is the normal state of an idle or one-way direction, so
+  // only operations that wait on the far end to make room or to answer, such
+  // as writes and connects, are marked as able to stall.
+  void suspend(const char* op, bool stalls)
+  {
+    pending = op;
+    can_stall = stalls;
+    since = steady_clock::now();
+  }
+
+  void resume()
+  {
+    pending = nullptr;
+  }
+};
+
+// Tracks every live session in an intrusive list, so that registering and
+// unregistering a session costs a few pointer writes and no allocation. The
+// registry belongs to one io_context and is not thread safe.
+class session_registry
+{
+public:
+  class session
+  {
+  public:
+    session(session_registry& registry, tcp::endpoint remote,
+        const steady_clock::time_point& deadline)
+      : registry_(registry),
+        id_(registry.next_id_++),
+        remote_(remote),
+        started_(steady_clock::now()),
+        deadline_(deadline)
+    {
+      next_ = registry_.head_;
+      if (next_)
+        next_->prev_ = this;
+      registry_.head_ = this;
+    }
+
+    session(const session&) = delete;
+    session& operator=(const session&) = delete;
+
+    ~session()
+    {
+      if (prev_)
+        prev_->next_ = next_;
+      else
+        registry_.head_ = next_;
+      if (next_)
+        next_->prev_ = prev_;
+    }
+
+    direction_state client_to_server;
+    direction_state server_to_client;
+
+  private:
+    friend class session_registry;
+
+    // Returns how long the session's oldest operation that can stall has
+    // been pending.
+    steady_clock::duration longest_stall(steady_clock::time_point now) const
+    {
+      steady_clock::duration longest{};
+      for (const direction_state* d : {&client_to_server, &server_to_client})
+        if (d->pending && d->can_stall)
+          longest = std::max(longest, now - d->since);
+      return longest;
+    }
+
+    session_registry& registry_;
+    session* prev_ = nullptr;
+    session* next_ = nullptr;
+    std::uint64_t id_;
+    tcp::endpoint remote_;
+    steady_clock::time_point started_;
+    const steady_clock::time_point& deadline_;
+    bool stalled_ = false;
+  };
+
+  session_registry() = default;
+  session_registry(const session_registry&) = delete;
+  session_registry& operator=(const session_registry&) = delete;
+
+  void dump(std::ostream& out) const
+  {
+    auto now = steady_clock::now();
+    std::size_t count = 0;
+    for (const session* s = head_; s; s = s->next_, ++count)
+      print(out, *s, now);
+    out << count << " sessions\n";
+  }
+
+  // Periodically looks for sessions whose pending write or connect has not
+  // completed within the threshold, however far the deadline has moved.
+  awaitable<void> scan(steady_clock::duration interval, steady_clock::duration threshold)
+  {
+    asio::steady_timer timer(co_await this_coro::executor);
+
+    for (;;)
+    {
+      timer.expires_after(interval);
+      auto [e] = co_await timer.async_wait(use_nothrow_awaitable);
+      if (e)
+        break;
+
+      auto now = steady_clock::now();
+      for (session* s = head_; s; s = s->next_)
+      {
+        bool stalled = s->longest_stall(now) > threshold;
+        if (stalled && !s->stalled_)
+        {
+          std::cout << "stalled: ";
+          print(std::cout, *s, now);
+        }
+        s->stalled_ = stalled;
+      }
+    }
+  }
+
+  awaitable<void> dump_on_signal()
+  {
+    asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+    for (;;)
+    {
+      auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+      if (e)
+        break;
+
+      dump(std::cout);
+    }
+  }
+
+private:
+  static void print(std::ostream& out, const session& s, steady_clock::time_point now)
+  {
+    out << "session " << s.id_ << " from " << s.remote_;
+    out << " age " << seconds(now - s.started_) << "s";
+    if (s.deadline_ > now)
+      out << ", deadline in " << seconds(s.deadline_ - now) << "s";
+    else if (s.deadline_ != steady_clock::time_point{})
+      out << ", deadline passed " << seconds(now - s.deadline_) << "s ago";
+
+    print(out, "client->server", s.client_to_server, now);
+    print(out, "server->client", s.server_to_client, now);
+    out << "\n";
+  }
+
+  static void print(std::ostream& out, const char* name,
+      const direction_state& d, steady_clock::time_point now)
+  {
+    out << ", " << name << " " << d.bytes << " bytes";
+    if (d.pending)
+      out << " " << d.pending << " pending " << seconds(now - d.since) << "s";
+  }
+
+  session* head_ = nullptr;
+  std::uint64_t next_id_ = 1;
+};
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to,
+    steady_clock::time_point& deadline, direction_state& state)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    deadline = std::max(deadline, steady_clock::now() + 5s);
+
+    state.suspend("read", false);
+    auto [e1, n1] = co_await from.async_read_some(buffer(data), use_nothrow_awaitable);
+    state.resume();
+    if (e1)
+      co_return;
+
+    state.suspend("write", true);
+    auto [e2, n2] = co_await async_write(to, buffer(data, n1), use_nothrow_awaitable);
+    state.resume();
+    if (e2)
+      co_return;
+
+    state.bytes += n2;
+  }
+}
+
+awaitable<void> watchdog(steady_clock::time_point& deadline)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+
+  auto now = steady_clock::now();
+  while (deadline > now)
+  {
+    timer.expires_at(deadline);
+    co_await timer.async_wait(use_nothrow_awaitable);
+    now = steady_clock::now();
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target, session_registry& registry)
+{
+  tcp::socket server(client.get_executor());
+  steady_clock::time_point deadline{};
+
+  std::error_code ec;
+  session_registry::session session(registry, client.remote_endpoint(ec), deadline);
+
+  session.client_to_server.suspend("connect", true);
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  session.client_to_server.resume();
+
+  if (!e)
+  {
+    co_await (
+        transfer(client, server, deadline, session.client_to_server) ||
+        transfer(server, client, deadline, session.server_to_client) ||
+        watchdog(deadline)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target, session_registry& registry)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target, registry), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5 && argc != 6)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<stall_seconds>]\n";
+      return 1;
+    }
+
+    std::chrono::seconds stall_threshold(argc == 6 ? std::stoul(argv[5]) : 30);
+
+    // Declared before the io_context, so that it outlives the sessions that
+    // are destroyed along with the io_context.
+    session_registry registry;
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, registry), detached);
+    co_spawn(ctx, registry.scan(1s, stall_threshold), detached);
+    co_spawn(ctx, registry.dump_on_signal(), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
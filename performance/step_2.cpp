@@ -0,0 +1,337 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+// A hashed timer wheel. Entries are kept in intrusive lists, one per slot, so
+// arming and disarming are O(1) and never allocate. A single steady_timer
+// drives the wheel, and only while it has entries. The wheel is not thread
+// safe, so each thread (or io_context) should have its own.
+class timer_wheel
+{
+public:
+  class entry
+  {
+  public:
+    entry() = default;
+    entry(const entry&) = delete;
+    entry& operator=(const entry&) = delete;
+
+    bool is_armed() const
+    {
+      return slot_ != unlinked;
+    }
+
+  protected:
+    ~entry() = default;
+
+  private:
+    friend class timer_wheel;
+
+    virtual void expire() = 0;
+
+    static constexpr std::size_t unlinked = ~std::size_t(0);
+
+    entry* prev_ = nullptr;
+    entry* next_ = nullptr;
+    std::size_t slot_ = unlinked;
+    std::size_t rounds_ = 0;
+  };
+
+  timer_wheel(asio::any_io_executor ex,
+      steady_clock::duration tick = 10ms,
+      std::size_t num_slots = 1024)
+    : tick_timer_(std::move(ex)),
+      tick_(tick),
+      slots_(num_slots, nullptr)
+  {
+  }
+
+  timer_wheel(const timer_wheel&) = delete;
+  timer_wheel& operator=(const timer_wheel&) = delete;
+
+  ~timer_wheel()
+  {
+    for (entry*& head : slots_)
+    {
+      for (entry* e = head; e; e = e->next_)
+        e->slot_ = entry::unlinked;
+      head = nullptr;
+    }
+  }
+
+  void arm(entry& e, steady_clock::time_point expiry)
+  {
+    disarm(e);
+
+    if (count_ == 0 && !ticking_)
+      cursor_time_ = steady_clock::now();
+
+    auto delay = expiry - cursor_time_;
+    std::size_t ticks = delay > steady_clock::duration::zero()
+      ? static_cast<std::size_t>((delay + tick_ - steady_clock::duration(1)) / tick_)
+      : 1;
+
+    std::size_t slot = (cursor_ + ticks) % slots_.size();
+    e.rounds_ = (ticks - 1) / slots_.size();
+    e.slot_ = slot;
+    e.prev_ = nullptr;
+    e.next_ = slots_[slot];
+    if (e.next_)
+      e.next_->prev_ = &e;
+    slots_[slot] = &e;
+    ++count_;
+
+    schedule();
+  }
+
+  void disarm(entry& e)
+  {
+    if (!e.is_armed())
+      return;
+
+    if (e.prev_)
+      e.prev_->next_ = e.next_;
+    else
+      slots_[e.slot_] = e.next_;
+    if (e.next_)
+      e.next_->prev_ = e.prev_;
+
+    e.prev_ = e.next_ = nullptr;
+    e.slot_ = entry::unlinked;
+    --count_;
+  }
+
+private:
+  void schedule()
+  {
+    if (count_ > 0 && !ticking_)
+    {
+      ticking_ = true;
+      tick_timer_.expires_at(cursor_time_ + tick_);
+      tick_timer_.async_wait(
+          [this](std::error_code error)
+          {
+            ticking_ = false;
+            if (!error)
+            {
+              advance(steady_clock::now());
+              schedule();
+            }
+          }
+        );
+    }
+  }
+
+  void advance(steady_clock::time_point now)
+  {
+    while (count_ > 0 && cursor_time_ + tick_ <= now)
+    {
+      cursor_time_ += tick_;
+      cursor_ = (cursor_ + 1) % slots_.size();
+
+      entry* e = slots_[cursor_];
+      while (e)
+      {
+        entry* next = e->next_;
+        if (e->rounds_ > 0)
+        {
+          --e->rounds_;
+        }
+        else
+        {
+          disarm(*e);
+          e->expire();
+        }
+        e = next;
+      }
+    }
+
+    if (count_ == 0)
+      cursor_time_ = now;
+  }
+
+  asio::steady_timer tick_timer_;
+  steady_clock::duration tick_;
+  std::vector<entry*> slots_;
+  std::size_t cursor_ = 0;
+  steady_clock::time_point cursor_time_ = steady_clock::now();
+  std::size_t count_ = 0;
+  bool ticking_ = false;
+};
+
+// A deadline that can be re-armed cheaply on every operation. Operations are
+// bound to the deadline's cancellation slot and complete with
+// operation_aborted when it expires. Because binding replaces the
+// coroutine's own cancellation slot, the deadline also follows the parent
+// slot so that cancellation from awaitable operators still gets through.
+class deadline
+  : private timer_wheel::entry
+{
+public:
+  explicit deadline(timer_wheel& wheel)
+    : wheel_(wheel)
+  {
+  }
+
+  ~deadline()
+  {
+    if (is_armed())
+      wheel_.disarm(*this);
+    if (parent_.is_connected())
+      parent_.clear();
+  }
+
+  void follow(asio::cancellation_slot parent)
+  {
+    parent_ = parent;
+    if (parent_.is_connected())
+    {
+      parent_.assign(
+          [this](asio::cancellation_type type)
+          {
+            signal_.emit(type);
+          }
+        );
+    }
+  }
+
+  void expires_after(steady_clock::duration duration)
+  {
+    wheel_.arm(*this, steady_clock::now() + duration);
+  }
+
+  void cancel()
+  {
+    wheel_.disarm(*this);
+  }
+
+  template <typename CompletionToken>
+  auto bind(CompletionToken&& token)
+  {
+    return asio::bind_cancellation_slot(
+        signal_.slot(),
+        std::forward<CompletionToken>(token)
+      );
+  }
+
+private:
+  void expire() override
+  {
+    signal_.emit(asio::cancellation_type::terminal);
+  }
+
+  timer_wheel& wheel_;
+  asio::cancellation_signal signal_;
+  asio::cancellation_slot parent_;
+};
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to, timer_wheel& wheel)
+{
+  std::array<char, 1024> data;
+
+  deadline timeout(wheel);
+  timeout.follow((co_await this_coro::cancellation_state).slot());
+
+  for (;;)
+  {
+    timeout.expires_after(5s);
+
+    auto [e1, n1] = co_await from.async_read_some(
+        buffer(data), timeout.bind(use_nothrow_awaitable));
+
+    if (e1)
+      break; // error or timed out
+
+    timeout.expires_after(1s);
+
+    auto [e2, n2] = co_await async_write(
+        to, buffer(data, n1), timeout.bind(use_nothrow_awaitable));
+
+    if (e2)
+      break; // error or timed out
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target, timer_wheel& wheel)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server, wheel) ||
+        transfer(server, client, wheel)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target, timer_wheel& wheel)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target, wheel), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    timer_wheel wheel(ctx.get_executor());
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, wheel), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
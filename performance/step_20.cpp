@@ -0,0 +1,189 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+// Reads are first attempted directly on the non-blocking socket, since the
+// data is often already waiting, saving a trip through the reactor and a
+// coroutine suspension. After this many speculative reads in a row, the
+// next read goes through the reactor, giving other sessions a turn.
+constexpr std::size_t max_speculative_reads = 16;
+
+struct read_statistics
+{
+  std::uint64_t speculative_reads = 0;
+  std::uint64_t round_trips_saved = 0; // speculative reads that returned data
+  std::uint64_t async_reads = 0;
+};
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to, read_statistics& stats)
+{
+  std::array<char, 1024> data;
+  std::size_t speculative_run = 0;
+
+  for (;;)
+  {
+    std::error_code e1 = asio::error::would_block;
+    std::size_t n1 = 0;
+
+    if (speculative_run < max_speculative_reads)
+    {
+      ++stats.speculative_reads;
+      n1 = from.read_some(buffer(data), e1);
+    }
+
+    if (!e1)
+    {
+      ++speculative_run;
+      ++stats.round_trips_saved;
+    }
+    else if (e1 == asio::error::would_block)
+    {
+      speculative_run = 0;
+      ++stats.async_reads;
+
+      auto result1 = co_await (
+          from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+          timeout(5s)
+        );
+
+      if (result1.index() == 1)
+        co_return; // timed out
+
+      std::tie(e1, n1) = std::get<0>(result1);
+      if (e1)
+        break;
+    }
+    else
+    {
+      break;
+    }
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target, read_statistics& stats)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    std::error_code ec;
+    client.non_blocking(true, ec);
+    if (!ec)
+      server.non_blocking(true, ec);
+    if (ec)
+      co_return;
+
+    co_await (
+        transfer(client, server, stats) ||
+        transfer(server, client, stats)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target, read_statistics& stats)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target, stats), detached);
+  }
+}
+
+awaitable<void> report_statistics(const read_statistics& stats)
+{
+  asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+  for (;;)
+  {
+    auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    std::cout << "reads: speculative=" << stats.speculative_reads;
+    std::cout << " round_trips_saved=" << stats.round_trips_saved;
+    std::cout << " async=" << stats.async_reads << "\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    read_statistics stats;
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, stats), detached);
+    co_spawn(ctx, report_statistics(stats), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,314 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <asio.hpp>
+
+using asio::buffer;
+using asio::ip::tcp;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+// Reads are first attempted directly on the non-blocking socket, since the
+// data is often already waiting, saving a trip through the reactor. After
+// this many speculative reads in a row, the next read goes through the
+// reactor, giving other sessions a turn.
+constexpr std::size_t max_speculative_reads = 16;
+
+struct read_statistics
+{
+  std::uint64_t speculative_reads = 0;
+  std::uint64_t round_trips_saved = 0; // speculative reads that returned data
+  std::uint64_t async_reads = 0;
+};
+
+class proxy
+  : public std::enable_shared_from_this<proxy>
+{
+public:
+  proxy(tcp::socket client, read_statistics& stats)
+    : client_(std::move(client)),
+      server_(client_.get_executor()),
+      watchdog_timer_(client_.get_executor()),
+      stats_(stats)
+  {
+  }
+
+  void connect_to_server(tcp::endpoint target)
+  {
+    auto self = shared_from_this();
+    server_.async_connect(
+        target,
+        [self](std::error_code error)
+        {
+          if (!error)
+          {
+            self->client_.non_blocking(true, error);
+            if (!error)
+              self->server_.non_blocking(true, error);
+            if (error)
+            {
+              self->stop();
+              return;
+            }
+
+            self->read_from_client();
+            self->read_from_server();
+            self->watchdog();
+          }
+        }
+      );
+  }
+
+private:
+  void stop()
+  {
+    client_.close();
+    server_.close();
+    watchdog_timer_.cancel();
+  }
+
+  bool is_stopped() const
+  {
+    return !client_.is_open() && !server_.is_open();
+  }
+
+  // Returns true if data was read without waiting, or if the read failed.
+  bool speculative_read(tcp::socket& socket, std::array<char, 1024>& data,
+      std::size_t& run, std::error_code& error, std::size_t& n)
+  {
+    if (run < max_speculative_reads)
+    {
+      ++stats_.speculative_reads;
+      n = socket.read_some(buffer(data), error);
+      if (!error)
+      {
+        ++run;
+        ++stats_.round_trips_saved;
+        return true;
+      }
+
+      if (error != asio::error::would_block)
+        return true;
+    }
+
+    run = 0;
+    ++stats_.async_reads;
+    return false;
+  }
+
+  void read_from_client()
+  {
+    deadline_ = std::max(deadline_, steady_clock::now() + 5s);
+
+    std::error_code error;
+    std::size_t n = 0;
+    if (speculative_read(client_, data_from_client_, client_run_, error, n))
+    {
+      if (!error)
+        write_to_server(n);
+      else
+        stop();
+      return;
+    }
+
+    auto self = shared_from_this();
+    client_.async_read_some(
+        buffer(data_from_client_),
+        [self](std::error_code error, std::size_t n)
+        {
+          if (!error)
+          {
+            self->write_to_server(n);
+          }
+          else
+          {
+            self->stop();
+          }
+        }
+      );
+  }
+
+  void write_to_server(std::size_t n)
+  {
+    auto self = shared_from_this();
+    async_write(
+        server_,
+        buffer(data_from_client_, n),
+        [self](std::error_code error, std::size_t /*n*/)
+        {
+          if (!error)
+          {
+            self->read_from_client();
+          }
+          else
+          {
+            self->stop();
+          }
+        }
+      );
+  }
+
+  void read_from_server()
+  {
+    deadline_ = std::max(deadline_, steady_clock::now() + 5s);
+
+    std::error_code error;
+    std::size_t n = 0;
+    if (speculative_read(server_, data_from_server_, server_run_, error, n))
+    {
+      if (!error)
+        write_to_client(n);
+      else
+        stop();
+      return;
+    }
+
+    auto self = shared_from_this();
+    server_.async_read_some(
+        buffer(data_from_server_),
+        [self](std::error_code error, std::size_t n)
+        {
+          if (!error)
+          {
+            self->write_to_client(n);
+          }
+          else
+          {
+            self->stop();
+          }
+        }
+      );
+  }
+
+  void write_to_client(std::size_t n)
+  {
+    auto self = shared_from_this();
+    async_write(
+        client_,
+        buffer(data_from_server_, n),
+        [self](std::error_code error, std::size_t /*n*/)
+        {
+          if (!error)
+          {
+            self->read_from_server();
+          }
+          else
+          {
+            self->stop();
+          }
+        }
+      );
+  }
+
+  void watchdog()
+  {
+    auto self = shared_from_this();
+    watchdog_timer_.expires_at(deadline_);
+    watchdog_timer_.async_wait(
+        [self](std::error_code /*error*/)
+        {
+          if (!self->is_stopped())
+          {
+            auto now = steady_clock::now();
+            if (self->deadline_ > now)
+            {
+              self->watchdog();
+            }
+            else
+            {
+              self->stop();
+            }
+          }
+        }
+      );
+  }
+
+  tcp::socket client_;
+  tcp::socket server_;
+  std::array<char, 1024> data_from_client_;
+  std::array<char, 1024> data_from_server_;
+  steady_clock::time_point deadline_;
+  asio::steady_timer watchdog_timer_;
+  std::size_t client_run_ = 0;
+  std::size_t server_run_ = 0;
+  read_statistics& stats_;
+};
+
+void listen(tcp::acceptor& acceptor, tcp::endpoint target, read_statistics& stats)
+{
+  acceptor.async_accept(
+      [&acceptor, target, &stats](std::error_code error, tcp::socket client)
+      {
+        if (!error)
+        {
+          std::make_shared<proxy>(
+              std::move(client),
+              stats
+            )->connect_to_server(target);
+        }
+
+        listen(acceptor, target, stats);
+      }
+    );
+}
+
+void report_statistics(asio::signal_set& signals, const read_statistics& stats)
+{
+  signals.async_wait(
+      [&signals, &stats](std::error_code error, int /*signo*/)
+      {
+        if (!error)
+        {
+          std::cout << "reads: speculative=" << stats.speculative_reads;
+          std::cout << " round_trips_saved=" << stats.round_trips_saved;
+          std::cout << " async=" << stats.async_reads << "\n";
+
+          report_statistics(signals, stats);
+        }
+      }
+    );
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    read_statistics stats;
+    asio::signal_set signals(ctx, SIGUSR1);
+
+    listen(acceptor, target_endpoint, stats);
+    report_statistics(signals, stats);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,313 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+constexpr std::size_t chunk_size = 4096;
+constexpr std::size_t chunk_count = 16;
+
+// How long the writer may hold back queued data in the hope of gathering
+// more, and how much queued data makes it write at once. While a write is in
+// flight, chunks queue up regardless, and are sent together when it ends.
+struct coalescing_policy
+{
+  steady_clock::duration max_delay = 0us;
+  std::size_t flush_bytes = 16384;
+};
+
+struct coalescing_statistics
+{
+  std::uint64_t writes = 0;
+  std::uint64_t chunks = 0;
+  std::uint64_t bytes = 0;
+};
+
+// A ring of chunks shared by the reading and writing halves of one direction.
+// Each read fills one chunk, and the writer sends every queued chunk with a
+// single gathered write. Timers that never expire are used as events.
+class chunk_queue
+{
+public:
+  explicit chunk_queue(const asio::any_io_executor& ex)
+    : data_ready_(ex, steady_clock::time_point::max()),
+      space_ready_(ex, steady_clock::time_point::max())
+  {
+  }
+
+  bool full() const
+  {
+    return count_ == chunk_count;
+  }
+
+  bool empty() const
+  {
+    return count_ == 0;
+  }
+
+  std::size_t size() const
+  {
+    return count_;
+  }
+
+  std::size_t bytes() const
+  {
+    return bytes_;
+  }
+
+  asio::mutable_buffer back()
+  {
+    return buffer(chunks_[(head_ + count_) % chunk_count]);
+  }
+
+  void push(std::size_t n)
+  {
+    sizes_[(head_ + count_) % chunk_count] = n;
+    ++count_;
+    bytes_ += n;
+    data_ready_.cancel();
+  }
+
+  // Returns every queued chunk as one buffer sequence. Unused entries are
+  // left empty, so the sequence needs no allocation.
+  std::array<asio::const_buffer, chunk_count> gather() const
+  {
+    std::array<asio::const_buffer, chunk_count> buffers;
+    for (std::size_t i = 0; i < count_; ++i)
+    {
+      std::size_t index = (head_ + i) % chunk_count;
+      buffers[i] = buffer(chunks_[index], sizes_[index]);
+    }
+    return buffers;
+  }
+
+  void pop(std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      bytes_ -= sizes_[head_];
+      head_ = (head_ + 1) % chunk_count;
+    }
+    count_ -= n;
+    space_ready_.cancel();
+  }
+
+  awaitable<void> wait_for_data()
+  {
+    co_await data_ready_.async_wait(use_nothrow_awaitable);
+  }
+
+  awaitable<void> wait_for_space()
+  {
+    co_await space_ready_.async_wait(use_nothrow_awaitable);
+  }
+
+private:
+  std::array<std::array<char, chunk_size>, chunk_count> chunks_;
+  std::array<std::size_t, chunk_count> sizes_{};
+  std::size_t head_ = 0;
+  std::size_t count_ = 0;
+  std::size_t bytes_ = 0;
+  asio::steady_timer data_ready_;
+  asio::steady_timer space_ready_;
+};
+
+awaitable<void> read_chunks(tcp::socket& from, chunk_queue& queue)
+{
+  for (;;)
+  {
+    while (queue.full())
+      co_await queue.wait_for_space();
+
+    auto result = co_await (
+        from.async_read_some(queue.back(), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result.index() == 1)
+      break; // timed out
+
+    auto [e, n] = std::get<0>(result);
+    if (e)
+      break;
+
+    queue.push(n);
+  }
+
+  // Let the writer finish sending what has already been read.
+  while (!queue.empty())
+    co_await queue.wait_for_space();
+}
+
+awaitable<void> write_chunks(tcp::socket& to, chunk_queue& queue,
+    const coalescing_policy& policy, coalescing_statistics& stats)
+{
+  for (;;)
+  {
+    while (queue.empty())
+      co_await queue.wait_for_data();
+
+    auto flush_time = steady_clock::now() + policy.max_delay;
+    while (!queue.full() && queue.bytes() < policy.flush_bytes)
+    {
+      auto now = steady_clock::now();
+      if (now >= flush_time)
+        break;
+
+      co_await (
+          queue.wait_for_data() ||
+          timeout(flush_time - now)
+        );
+    }
+
+    std::size_t chunks = queue.size();
+
+    auto result = co_await (
+        async_write(to, queue.gather(), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result.index() == 1)
+      co_return; // timed out
+
+    auto [e, n] = std::get<0>(result);
+    if (e)
+      co_return;
+
+    ++stats.writes;
+    stats.chunks += chunks;
+    stats.bytes += n;
+
+    queue.pop(chunks);
+  }
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to,
+    const coalescing_policy& policy, coalescing_statistics& stats)
+{
+  chunk_queue queue(co_await this_coro::executor);
+
+  co_await (
+      read_chunks(from, queue) ||
+      write_chunks(to, queue, policy, stats)
+    );
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target,
+    const coalescing_policy& policy, coalescing_statistics& stats)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server, policy, stats) ||
+        transfer(server, client, policy, stats)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target,
+    const coalescing_policy& policy, coalescing_statistics& stats)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target, policy, stats), detached);
+  }
+}
+
+awaitable<void> report_statistics(const coalescing_statistics& stats)
+{
+  asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+  for (;;)
+  {
+    auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    std::cout << "writes=" << stats.writes;
+    std::cout << " chunks=" << stats.chunks;
+    std::cout << " bytes=" << stats.bytes;
+    std::cout << " chunks_per_write=" << (stats.writes ? double(stats.chunks) / stats.writes : 0.0);
+    std::cout << "\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5 && argc != 7)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<max_delay_us> <flush_bytes>]\n";
+      return 1;
+    }
+
+    coalescing_policy policy;
+    if (argc == 7)
+    {
+      policy.max_delay = std::chrono::microseconds(std::stoul(argv[5]));
+      policy.flush_bytes = std::stoul(argv[6]);
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    coalescing_statistics stats;
+
+    co_spawn(ctx, listen(acceptor, target_endpoint, policy, stats), detached);
+    co_spawn(ctx, report_statistics(stats), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,298 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+// A per-thread pool of I/O buffers in a few size classes. Buffers are carved
+// out of larger slabs and recycled through intrusive free lists, so a session
+// only costs memory while it has a read or write in progress. Buffers must be
+// released on the thread that acquired them.
+class buffer_pool
+{
+public:
+  static constexpr std::array<std::size_t, 3> size_classes{4096, 16384, 65536};
+  static constexpr std::size_t slab_size = 256 * 1024;
+
+  struct statistics
+  {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t bytes_outstanding = 0;
+  };
+
+  class buffer
+  {
+  public:
+    buffer() = default;
+
+    buffer(buffer&& other) noexcept
+      : pool_(std::exchange(other.pool_, nullptr)),
+        class_index_(other.class_index_),
+        data_(std::exchange(other.data_, nullptr))
+    {
+    }
+
+    buffer& operator=(buffer&& other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        pool_ = std::exchange(other.pool_, nullptr);
+        class_index_ = other.class_index_;
+        data_ = std::exchange(other.data_, nullptr);
+      }
+      return *this;
+    }
+
+    ~buffer()
+    {
+      reset();
+    }
+
+    void reset()
+    {
+      if (pool_)
+      {
+        pool_->release(class_index_, data_);
+        pool_ = nullptr;
+        data_ = nullptr;
+      }
+    }
+
+    char* data() const
+    {
+      return data_;
+    }
+
+    std::size_t size() const
+    {
+      return pool_ ? size_classes[class_index_] : 0;
+    }
+
+  private:
+    friend class buffer_pool;
+
+    buffer(buffer_pool* pool, std::size_t class_index, char* data)
+      : pool_(pool),
+        class_index_(class_index),
+        data_(data)
+    {
+    }
+
+    buffer_pool* pool_ = nullptr;
+    std::size_t class_index_ = 0;
+    char* data_ = nullptr;
+  };
+
+  static buffer_pool& local()
+  {
+    thread_local buffer_pool pool;
+    return pool;
+  }
+
+  buffer acquire(std::size_t size_hint)
+  {
+    std::size_t class_index = 0;
+    while (class_index + 1 < size_classes.size()
+        && size_classes[class_index] < size_hint)
+      ++class_index;
+
+    free_block*& head = free_lists_[class_index];
+    if (head)
+    {
+      ++stats_.hits;
+    }
+    else
+    {
+      ++stats_.misses;
+      allocate_slab(class_index);
+    }
+
+    free_block* block = head;
+    head = block->next;
+    stats_.bytes_outstanding += size_classes[class_index];
+    return buffer(this, class_index, reinterpret_cast<char*>(block));
+  }
+
+  statistics stats() const
+  {
+    return stats_;
+  }
+
+private:
+  struct free_block
+  {
+    free_block* next;
+  };
+
+  void allocate_slab(std::size_t class_index)
+  {
+    std::size_t block_size = size_classes[class_index];
+    std::size_t num_blocks = std::max<std::size_t>(slab_size / block_size, 1);
+    slabs_.emplace_back(new char[block_size * num_blocks]);
+
+    char* slab = slabs_.back().get();
+    for (std::size_t i = 0; i < num_blocks; ++i)
+    {
+      auto block = reinterpret_cast<free_block*>(slab + i * block_size);
+      block->next = free_lists_[class_index];
+      free_lists_[class_index] = block;
+    }
+  }
+
+  void release(std::size_t class_index, char* data)
+  {
+    auto block = reinterpret_cast<free_block*>(data);
+    block->next = free_lists_[class_index];
+    free_lists_[class_index] = block;
+    stats_.bytes_outstanding -= size_classes[class_index];
+  }
+
+  std::array<free_block*, size_classes.size()> free_lists_{};
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  statistics stats_;
+};
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::size_t size_hint = buffer_pool::size_classes[0];
+
+  for (;;)
+  {
+    auto data = buffer_pool::local().acquire(size_hint);
+
+    auto result1 = co_await (
+        from.async_read_some(buffer(data.data(), data.size()), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data.data(), n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+
+    // Grow towards the largest size class while reads fill the buffer.
+    size_hint = n1 == data.size() ? data.size() * 4 : n1;
+  }
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> report_statistics()
+{
+  asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+  for (;;)
+  {
+    auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto stats = buffer_pool::local().stats();
+    std::cout << "buffer pool: hits=" << stats.hits;
+    std::cout << " misses=" << stats.misses;
+    std::cout << " bytes_outstanding=" << stats.bytes_outstanding << "\n";
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+    co_spawn(ctx, report_statistics(), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,336 @@
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <utility>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+// A per-thread cache of coroutine frames, bucketed into 64-byte size classes.
+// Frames are returned to the cache of the thread that allocated them.
+class frame_recycler
+{
+public:
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t num_classes = 64;
+  static constexpr std::size_t max_cached_per_class = 1024;
+
+  struct statistics
+  {
+    std::size_t allocations = 0;
+    std::size_t recycled = 0;
+  };
+
+  static frame_recycler& local()
+  {
+    thread_local frame_recycler recycler;
+    return recycler;
+  }
+
+  frame_recycler() = default;
+  frame_recycler(const frame_recycler&) = delete;
+  frame_recycler& operator=(const frame_recycler&) = delete;
+
+  ~frame_recycler()
+  {
+    for (cached_frame*& head : cache_)
+    {
+      while (head)
+        ::operator delete(std::exchange(head, head->next));
+    }
+  }
+
+  void* allocate(std::size_t size)
+  {
+    ++stats_.allocations;
+
+    std::size_t index = class_index(size);
+    if (index < num_classes)
+    {
+      if (cached_frame* frame = cache_[index])
+      {
+        cache_[index] = frame->next;
+        --cached_count_[index];
+        ++stats_.recycled;
+        return frame;
+      }
+
+      return ::operator new((index + 1) * granularity);
+    }
+
+    return ::operator new(size);
+  }
+
+  void deallocate(void* pointer, std::size_t size)
+  {
+    std::size_t index = class_index(size);
+    if (index < num_classes && cached_count_[index] < max_cached_per_class)
+    {
+      auto frame = static_cast<cached_frame*>(pointer);
+      frame->next = cache_[index];
+      cache_[index] = frame;
+      ++cached_count_[index];
+    }
+    else
+    {
+      ::operator delete(pointer);
+    }
+  }
+
+  statistics stats() const
+  {
+    return stats_;
+  }
+
+private:
+  struct cached_frame
+  {
+    cached_frame* next;
+  };
+
+  static std::size_t class_index(std::size_t size)
+  {
+    return (size + granularity - 1) / granularity - 1;
+  }
+
+  std::array<cached_frame*, num_classes> cache_{};
+  std::array<std::size_t, num_classes> cached_count_{};
+  statistics stats_;
+};
+
+// Passed as std::allocator_arg, frame_allocator selects the frame_recycler
+// used for a coroutine's frame. A default-constructed allocator uses the
+// global operator new. The recycler is recorded in a small header in front of
+// the frame so that it can be found again when the frame is destroyed.
+class frame_allocator
+{
+public:
+  frame_allocator() = default;
+
+  explicit frame_allocator(frame_recycler& recycler)
+    : recycler_(&recycler)
+  {
+  }
+
+  void* allocate(std::size_t size) const
+  {
+    void* pointer = recycler_
+      ? recycler_->allocate(size + header_size)
+      : ::operator new(size + header_size);
+
+    *static_cast<frame_recycler**>(pointer) = recycler_;
+    return static_cast<std::byte*>(pointer) + header_size;
+  }
+
+  static void deallocate(void* frame, std::size_t size)
+  {
+    void* pointer = static_cast<std::byte*>(frame) - header_size;
+    if (frame_recycler* recycler = *static_cast<frame_recycler**>(pointer))
+      recycler->deallocate(pointer, size + header_size);
+    else
+      ::operator delete(pointer);
+  }
+
+private:
+  static constexpr std::size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+  frame_recycler* recycler_ = nullptr;
+};
+
+// Any awaitable<> coroutine whose first two parameters are std::allocator_arg
+// and a frame_allocator gets its frame from that allocator. Apart from
+// allocation the promise is Asio's own, but awaitable<> only accepts being
+// awaited from a coroutine_handle to Asio's promise type, so awaits are
+// adapted to present the handle in that form.
+template <typename T, typename Executor, typename... Args>
+struct std::coroutine_traits<asio::awaitable<T, Executor>,
+    std::allocator_arg_t, frame_allocator, Args...>
+{
+  struct promise_type
+    : asio::detail::awaitable_frame<T, Executor>
+  {
+    using frame_type = asio::detail::awaitable_frame<T, Executor>;
+
+    template <typename U>
+    struct awaiter
+    {
+      asio::awaitable<U, Executor> awaitable;
+
+      bool await_ready() const noexcept
+      {
+        return awaitable.await_ready();
+      }
+
+      void await_suspend(std::coroutine_handle<promise_type> h)
+      {
+        awaitable.await_suspend(
+            std::coroutine_handle<frame_type>::from_promise(h.promise()));
+      }
+
+      U await_resume()
+      {
+        return awaitable.await_resume();
+      }
+    };
+
+    static void* operator new(std::size_t size,
+        std::allocator_arg_t, const frame_allocator& alloc, const Args&...)
+    {
+      return alloc.allocate(size);
+    }
+
+    static void operator delete(void* pointer, std::size_t size)
+    {
+      frame_allocator::deallocate(pointer, size);
+    }
+
+    using frame_type::await_transform;
+
+    template <typename U>
+    awaiter<U> await_transform(asio::awaitable<U, Executor> a)
+    {
+      return awaiter<U>{frame_type::await_transform(std::move(a))};
+    }
+  };
+};
+
+awaitable<void> timeout(std::allocator_arg_t, frame_allocator,
+    steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(std::allocator_arg_t, frame_allocator alloc,
+    tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(std::allocator_arg, alloc, 5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(std::allocator_arg, alloc, 1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+awaitable<void> proxy(std::allocator_arg_t, frame_allocator alloc,
+    tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(std::allocator_arg, alloc, client, server) ||
+        transfer(std::allocator_arg, alloc, server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    frame_allocator alloc(frame_recycler::local());
+    co_spawn(ex, proxy(std::allocator_arg, alloc, std::move(client), target), detached);
+  }
+}
+
+awaitable<void> report_statistics()
+{
+  asio::signal_set signals(co_await this_coro::executor, SIGUSR1);
+
+  for (;;)
+  {
+    auto [e, signo] = co_await signals.async_wait(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto stats = frame_recycler::local().stats();
+    std::cout << "frame recycler: allocations=" << stats.allocations;
+    std::cout << " allocations_removed=" << stats.recycled << "\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+    co_spawn(ctx, report_statistics(), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,321 @@
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <asio.hpp>
+
+using asio::buffer;
+using asio::ip::tcp;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+// Memory for one outstanding operation's handler. Operations are issued one
+// at a time per slot, so after the first use the slot is always free when the
+// next operation starts and no heap allocation takes place.
+class handler_memory
+{
+public:
+  handler_memory() = default;
+  handler_memory(const handler_memory&) = delete;
+  handler_memory& operator=(const handler_memory&) = delete;
+
+  void* allocate(std::size_t size)
+  {
+    if (!in_use_ && size <= sizeof(storage_))
+    {
+      in_use_ = true;
+      return &storage_;
+    }
+
+    return ::operator new(size);
+  }
+
+  void deallocate(void* pointer)
+  {
+    if (pointer == &storage_)
+    {
+      in_use_ = false;
+    }
+    else
+    {
+      ::operator delete(pointer);
+    }
+  }
+
+private:
+  alignas(std::max_align_t) unsigned char storage_[512];
+  bool in_use_ = false;
+};
+
+template <typename T>
+class handler_allocator
+{
+public:
+  using value_type = T;
+
+  explicit handler_allocator(handler_memory& memory)
+    : memory_(memory)
+  {
+  }
+
+  template <typename U>
+  handler_allocator(const handler_allocator<U>& other) noexcept
+    : memory_(other.memory_)
+  {
+  }
+
+  bool operator==(const handler_allocator& other) const noexcept
+  {
+    return &memory_ == &other.memory_;
+  }
+
+  bool operator!=(const handler_allocator& other) const noexcept
+  {
+    return &memory_ != &other.memory_;
+  }
+
+  T* allocate(std::size_t n) const
+  {
+    return static_cast<T*>(memory_.allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* pointer, std::size_t /*n*/) const
+  {
+    memory_.deallocate(pointer);
+  }
+
+private:
+  template <typename> friend class handler_allocator;
+
+  handler_memory& memory_;
+};
+
+// Each chain of operations owns a reference to the proxy, which is moved from
+// one handler to the next rather than copied from shared_from_this(). Only
+// starting a chain touches the reference count.
+class proxy
+  : public std::enable_shared_from_this<proxy>
+{
+public:
+  proxy(tcp::socket client)
+    : client_(std::move(client)),
+      server_(client_.get_executor()),
+      watchdog_timer_(client_.get_executor())
+  {
+  }
+
+  void connect_to_server(tcp::endpoint target)
+  {
+    auto self = shared_from_this();
+    server_.async_connect(
+        target,
+        [self](std::error_code error) mutable
+        {
+          if (!error)
+          {
+            self->read_from_client(self);
+            self->read_from_server(self);
+            self->watchdog(std::move(self));
+          }
+        }
+      );
+  }
+
+private:
+  using self_ptr = std::shared_ptr<proxy>;
+
+  void stop()
+  {
+    client_.close();
+    server_.close();
+    watchdog_timer_.cancel();
+  }
+
+  bool is_stopped() const
+  {
+    return !client_.is_open() && !server_.is_open();
+  }
+
+  void read_from_client(self_ptr self)
+  {
+    deadline_ = std::max(deadline_, steady_clock::now() + 5s);
+
+    client_.async_read_some(
+        buffer(data_from_client_),
+        asio::bind_allocator(
+          handler_allocator<int>(read_from_client_memory_),
+          [self = std::move(self)](std::error_code error, std::size_t n) mutable
+          {
+            if (!error)
+            {
+              self->write_to_server(std::move(self), n);
+            }
+            else
+            {
+              self->stop();
+            }
+          }
+        )
+      );
+  }
+
+  void write_to_server(self_ptr self, std::size_t n)
+  {
+    async_write(
+        server_,
+        buffer(data_from_client_, n),
+        asio::bind_allocator(
+          handler_allocator<int>(write_to_server_memory_),
+          [self = std::move(self)](std::error_code error, std::size_t /*n*/) mutable
+          {
+            if (!error)
+            {
+              self->read_from_client(std::move(self));
+            }
+            else
+            {
+              self->stop();
+            }
+          }
+        )
+      );
+  }
+
+  void read_from_server(self_ptr self)
+  {
+    deadline_ = std::max(deadline_, steady_clock::now() + 5s);
+
+    server_.async_read_some(
+        buffer(data_from_server_),
+        asio::bind_allocator(
+          handler_allocator<int>(read_from_server_memory_),
+          [self = std::move(self)](std::error_code error, std::size_t n) mutable
+          {
+            if (!error)
+            {
+              self->write_to_client(std::move(self), n);
+            }
+            else
+            {
+              self->stop();
+            }
+          }
+        )
+      );
+  }
+
+  void write_to_client(self_ptr self, std::size_t n)
+  {
+    async_write(
+        client_,
+        buffer(data_from_server_, n),
+        asio::bind_allocator(
+          handler_allocator<int>(write_to_client_memory_),
+          [self = std::move(self)](std::error_code error, std::size_t /*n*/) mutable
+          {
+            if (!error)
+            {
+              self->read_from_server(std::move(self));
+            }
+            else
+            {
+              self->stop();
+            }
+          }
+        )
+      );
+  }
+
+  void watchdog(self_ptr self)
+  {
+    watchdog_timer_.expires_at(deadline_);
+    watchdog_timer_.async_wait(
+        asio::bind_allocator(
+          handler_allocator<int>(watchdog_memory_),
+          [self = std::move(self)](std::error_code /*error*/) mutable
+          {
+            if (!self->is_stopped())
+            {
+              auto now = steady_clock::now();
+              if (self->deadline_ > now)
+              {
+                self->watchdog(std::move(self));
+              }
+              else
+              {
+                self->stop();
+              }
+            }
+          }
+        )
+      );
+  }
+
+  tcp::socket client_;
+  tcp::socket server_;
+  std::array<char, 1024> data_from_client_;
+  std::array<char, 1024> data_from_server_;
+  steady_clock::time_point deadline_;
+  asio::steady_timer watchdog_timer_;
+  handler_memory read_from_client_memory_;
+  handler_memory write_to_server_memory_;
+  handler_memory read_from_server_memory_;
+  handler_memory write_to_client_memory_;
+  handler_memory watchdog_memory_;
+};
+
+void listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  acceptor.async_accept(
+      [&acceptor, target](std::error_code error, tcp::socket client)
+      {
+        if (!error)
+        {
+          std::make_shared<proxy>(
+              std::move(client)
+            )->connect_to_server(target);
+        }
+
+        listen(acceptor, target);
+      }
+    );
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    listen(acceptor, target_endpoint);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
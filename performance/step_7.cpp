@@ -0,0 +1,224 @@
+#include <array>
+#include <iostream>
+#include <memory>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+constexpr std::size_t read_ahead_buffer_size = 8192;
+constexpr std::size_t read_ahead_buffer_count = 4;
+constexpr std::size_t max_bytes_in_flight = 16384;
+
+// A ring of buffers shared by the reading and writing halves of one
+// direction. The reader may run ahead of the writer by up to
+// read_ahead_buffer_count buffers, or max_bytes_in_flight bytes, whichever
+// limit is reached first. Timers that never expire are used as events.
+class read_ahead_queue
+{
+public:
+  explicit read_ahead_queue(const asio::any_io_executor& ex)
+    : data_ready_(ex, steady_clock::time_point::max()),
+      space_ready_(ex, steady_clock::time_point::max())
+  {
+  }
+
+  bool full() const
+  {
+    return count_ == read_ahead_buffer_count || bytes_ >= max_bytes_in_flight;
+  }
+
+  bool empty() const
+  {
+    return count_ == 0;
+  }
+
+  asio::mutable_buffer back()
+  {
+    return buffer(buffers_[(head_ + count_) % read_ahead_buffer_count]);
+  }
+
+  void push(std::size_t n)
+  {
+    sizes_[(head_ + count_) % read_ahead_buffer_count] = n;
+    ++count_;
+    bytes_ += n;
+    data_ready_.cancel();
+  }
+
+  asio::const_buffer front() const
+  {
+    return buffer(buffers_[head_], sizes_[head_]);
+  }
+
+  void pop()
+  {
+    bytes_ -= sizes_[head_];
+    head_ = (head_ + 1) % read_ahead_buffer_count;
+    --count_;
+    space_ready_.cancel();
+  }
+
+  awaitable<void> wait_for_data()
+  {
+    co_await data_ready_.async_wait(use_nothrow_awaitable);
+  }
+
+  awaitable<void> wait_for_space()
+  {
+    co_await space_ready_.async_wait(use_nothrow_awaitable);
+  }
+
+private:
+  std::array<std::array<char, read_ahead_buffer_size>, read_ahead_buffer_count> buffers_;
+  std::array<std::size_t, read_ahead_buffer_count> sizes_{};
+  std::size_t head_ = 0;
+  std::size_t count_ = 0;
+  std::size_t bytes_ = 0;
+  asio::steady_timer data_ready_;
+  asio::steady_timer space_ready_;
+};
+
+awaitable<void> read_ahead(tcp::socket& from, read_ahead_queue& queue)
+{
+  for (;;)
+  {
+    while (queue.full())
+      co_await queue.wait_for_space();
+
+    auto result = co_await (
+        from.async_read_some(queue.back(), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result.index() == 1)
+      break; // timed out
+
+    auto [e, n] = std::get<0>(result);
+    if (e)
+      break;
+
+    queue.push(n);
+  }
+
+  // Let the writer finish sending what has already been read.
+  while (!queue.empty())
+    co_await queue.wait_for_space();
+}
+
+awaitable<void> write_behind(tcp::socket& to, read_ahead_queue& queue)
+{
+  for (;;)
+  {
+    while (queue.empty())
+      co_await queue.wait_for_data();
+
+    auto result = co_await (
+        async_write(to, queue.front(), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result.index() == 1)
+      co_return; // timed out
+
+    auto [e, n] = std::get<0>(result);
+    if (e)
+      co_return;
+
+    queue.pop();
+  }
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  read_ahead_queue queue(co_await this_coro::executor);
+
+  co_await (
+      read_ahead(from, queue) ||
+      write_behind(to, queue)
+    );
+}
+
+awaitable<void> proxy(tcp::socket client, tcp::endpoint target)
+{
+  tcp::socket server(client.get_executor());
+
+  auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, tcp::endpoint target)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), target), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>\n";
+      return 1;
+    }
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    co_spawn(ctx, listen(acceptor, target_endpoint), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,205 @@
+#include <array>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+// Keeps a number of idle connections to one backend endpoint, so that a new
+// session does not have to wait for a TCP handshake. Idle connections that
+// the backend has closed are detected with a non-blocking peek, both when a
+// connection is handed out and in a periodic sweep.
+class connection_pool
+{
+public:
+  connection_pool(const asio::any_io_executor& ex,
+      tcp::endpoint target, std::size_t size)
+    : target_(target),
+      size_(size),
+      refill_timer_(ex)
+  {
+  }
+
+  awaitable<std::tuple<std::error_code, tcp::socket>> acquire()
+  {
+    while (!idle_.empty())
+    {
+      tcp::socket server = std::move(idle_.front());
+      idle_.pop_front();
+      refill_timer_.cancel();
+
+      if (is_alive(server))
+        co_return std::tuple(std::error_code(), std::move(server));
+    }
+
+    tcp::socket server(refill_timer_.get_executor());
+    auto [e] = co_await server.async_connect(target_, use_nothrow_awaitable);
+    co_return std::tuple(e, std::move(server));
+  }
+
+  awaitable<void> maintain()
+  {
+    for (;;)
+    {
+      evict_closed();
+
+      while (idle_.size() < size_)
+      {
+        tcp::socket server(refill_timer_.get_executor());
+        auto [e] = co_await server.async_connect(target_, use_nothrow_awaitable);
+        if (e)
+          break; // try again after the next sweep interval
+
+        server.non_blocking(true, e);
+        if (!e)
+          idle_.push_back(std::move(server));
+      }
+
+      refill_timer_.expires_after(1s);
+      co_await refill_timer_.async_wait(use_nothrow_awaitable);
+    }
+  }
+
+private:
+  static bool is_alive(tcp::socket& server)
+  {
+    char data;
+    std::error_code error;
+    server.receive(buffer(&data, 1), tcp::socket::message_peek, error);
+    return error == asio::error::would_block;
+  }
+
+  void evict_closed()
+  {
+    std::erase_if(idle_, [](tcp::socket& server){ return !is_alive(server); });
+  }
+
+  tcp::endpoint target_;
+  std::size_t size_;
+  std::deque<tcp::socket> idle_;
+  asio::steady_timer refill_timer_;
+};
+
+awaitable<void> proxy(tcp::socket client, connection_pool& pool)
+{
+  auto [e, server] = co_await pool.acquire();
+  if (!e)
+  {
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, connection_pool& pool)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), pool), detached);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc != 5 && argc != 6)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<pool_size>]\n";
+      return 1;
+    }
+
+    std::size_t pool_size = argc == 6 ? std::stoul(argv[5]) : 16;
+
+    asio::io_context ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    auto target_endpoint =
+      *tcp::resolver(ctx).resolve(
+          argv[3],
+          argv[4]
+        );
+
+    tcp::acceptor acceptor(ctx, listen_endpoint);
+
+    connection_pool pool(ctx.get_executor(), target_endpoint, pool_size);
+
+    co_spawn(ctx, pool.maintain(), detached);
+    co_spawn(ctx, listen(acceptor, pool), detached);
+
+    ctx.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,375 @@
+#include <array>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include <asio/experimental/as_tuple.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+
+#if defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+using asio::awaitable;
+using asio::buffer;
+using asio::co_spawn;
+using asio::detached;
+using asio::ip::tcp;
+namespace this_coro = asio::this_coro;
+using namespace asio::experimental::awaitable_operators;
+using std::chrono::steady_clock;
+using namespace std::literals::chrono_literals;
+
+constexpr auto use_nothrow_awaitable = asio::experimental::as_tuple(asio::use_awaitable);
+
+awaitable<void> timeout(steady_clock::duration duration)
+{
+  asio::steady_timer timer(co_await this_coro::executor);
+  timer.expires_after(duration);
+  co_await timer.async_wait(use_nothrow_awaitable);
+}
+
+awaitable<void> transfer(tcp::socket& from, tcp::socket& to)
+{
+  std::array<char, 1024> data;
+
+  for (;;)
+  {
+    auto result1 = co_await (
+        from.async_read_some(buffer(data), use_nothrow_awaitable) ||
+        timeout(5s)
+      );
+
+    if (result1.index() == 1)
+      co_return; // timed out
+
+    auto [e1, n1] = std::get<0>(result1);
+    if (e1)
+      break;
+
+    auto result2 = co_await (
+        async_write(to, buffer(data, n1), use_nothrow_awaitable) ||
+        timeout(1s)
+      );
+
+    if (result2.index() == 1)
+      co_return; // timed out
+
+    auto [e2, n2] = std::get<0>(result2);
+    if (e2)
+      break;
+  }
+}
+
+enum class balancing_policy
+{
+  round_robin,
+  least_active,
+  power_of_two_choices,
+  latency_ewma
+};
+
+// The set of backends, together with the state used to choose between them.
+// Each shard has its own copy, so selection never touches memory shared with
+// another thread. The active counts and latency estimates are therefore per
+// shard, which with SO_REUSEPORT balancing is a close approximation of the
+// global picture.
+class backend_set
+{
+public:
+  struct backend
+  {
+    tcp::endpoint endpoint;
+    std::size_t active = 0;
+    double latency_ewma = 0.0; // seconds
+    bool measured = false;
+  };
+
+  backend_set(balancing_policy policy, const std::vector<tcp::endpoint>& endpoints)
+    : policy_(policy),
+      random_(std::random_device()())
+  {
+    for (const auto& endpoint : endpoints)
+      backends_.push_back(backend{endpoint});
+  }
+
+  backend& select()
+  {
+    switch (policy_)
+    {
+    case balancing_policy::round_robin:
+      return backends_[next_++ % backends_.size()];
+    case balancing_policy::least_active:
+      return least_active();
+    case balancing_policy::power_of_two_choices:
+      return power_of_two_choices();
+    case balancing_policy::latency_ewma:
+      return lowest_latency();
+    }
+
+    return backends_.front();
+  }
+
+  void record_connect(backend& b, steady_clock::duration duration)
+  {
+    constexpr double decay = 0.2;
+    double sample = std::chrono::duration<double>(duration).count();
+    b.latency_ewma = b.measured
+      ? decay * sample + (1.0 - decay) * b.latency_ewma
+      : sample;
+    b.measured = true;
+  }
+
+private:
+  backend& least_active()
+  {
+    // Start the scan at a rotating position so that ties are spread out.
+    std::size_t start = next_++;
+    backend* best = &backends_[start % backends_.size()];
+    for (std::size_t i = 1; i < backends_.size(); ++i)
+    {
+      backend& b = backends_[(start + i) % backends_.size()];
+      if (b.active < best->active)
+        best = &b;
+    }
+    return *best;
+  }
+
+  backend& power_of_two_choices()
+  {
+    if (backends_.size() == 1)
+      return backends_.front();
+
+    std::uniform_int_distribution<std::size_t> dist(0, backends_.size() - 1);
+    std::size_t i = dist(random_);
+    std::size_t j = dist(random_);
+    if (i == j)
+      j = (j + 1) % backends_.size();
+
+    return backends_[i].active <= backends_[j].active ? backends_[i] : backends_[j];
+  }
+
+  backend& lowest_latency()
+  {
+    // Unmeasured backends are tried first. Otherwise, the expected latency is
+    // scaled by the load already on each backend.
+    backend* best = nullptr;
+    double best_cost = std::numeric_limits<double>::max();
+    std::size_t start = next_++;
+    for (std::size_t i = 0; i < backends_.size(); ++i)
+    {
+      backend& b = backends_[(start + i) % backends_.size()];
+      if (!b.measured)
+        return b;
+
+      double cost = b.latency_ewma * static_cast<double>(b.active + 1);
+      if (cost < best_cost)
+      {
+        best = &b;
+        best_cost = cost;
+      }
+    }
+    return *best;
+  }
+
+  balancing_policy policy_;
+  std::vector<backend> backends_;
+  std::size_t next_ = 0;
+  std::minstd_rand random_;
+};
+
+awaitable<void> proxy(tcp::socket client, backend_set& backends)
+{
+  tcp::socket server(client.get_executor());
+
+  auto& backend = backends.select();
+  ++backend.active;
+  struct active_guard
+  {
+    backend_set::backend& b;
+    ~active_guard() { --b.active; }
+  } guard{backend};
+
+  auto start = steady_clock::now();
+  auto [e] = co_await server.async_connect(backend.endpoint, use_nothrow_awaitable);
+  if (!e)
+  {
+    backends.record_connect(backend, steady_clock::now() - start);
+
+    co_await (
+        transfer(client, server) ||
+        transfer(server, client)
+      );
+  }
+  else
+  {
+    backends.record_connect(backend, 1s); // penalise failed backends
+  }
+}
+
+awaitable<void> listen(tcp::acceptor& acceptor, backend_set& backends)
+{
+  for (;;)
+  {
+    auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+    if (e)
+      break;
+
+    auto ex = client.get_executor();
+    co_spawn(ex, proxy(std::move(client), backends), detached);
+  }
+}
+
+#if defined(SO_REUSEPORT)
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+tcp::acceptor make_acceptor(asio::io_context& ctx, tcp::endpoint listen_endpoint)
+{
+  tcp::acceptor acceptor(ctx);
+  acceptor.open(listen_endpoint.protocol());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+#if defined(SO_REUSEPORT)
+  acceptor.set_option(reuse_port(true));
+#endif
+  acceptor.bind(listen_endpoint);
+  acceptor.listen();
+  return acceptor;
+}
+
+void pin_to_cpu(std::size_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % CPU_SETSIZE, &cpus);
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void)cpu;
+#endif
+}
+
+// Each shard owns an io_context that is run by exactly one thread. Sessions
+// are spawned on the executor of the acceptor that accepted them, so all of a
+// session's work stays on that thread and needs no synchronisation.
+struct shard
+{
+  shard(tcp::endpoint listen_endpoint,
+      balancing_policy policy, const std::vector<tcp::endpoint>& target_endpoints)
+    : backends(policy, target_endpoints),
+      acceptor(make_acceptor(ctx, listen_endpoint))
+  {
+    co_spawn(ctx, listen(acceptor, backends), detached);
+  }
+
+  void run(std::size_t cpu)
+  {
+    pin_to_cpu(cpu);
+    ctx.run();
+  }
+
+  // Declared before the io_context, which destroys suspended sessions that
+  // still refer to it.
+  backend_set backends;
+  asio::io_context ctx{1};
+  tcp::acceptor acceptor;
+};
+
+balancing_policy parse_policy(const std::string& name)
+{
+  if (name == "round_robin")
+    return balancing_policy::round_robin;
+  if (name == "least_active")
+    return balancing_policy::least_active;
+  if (name == "power_of_two")
+    return balancing_policy::power_of_two_choices;
+  if (name == "latency_ewma")
+    return balancing_policy::latency_ewma;
+  throw std::invalid_argument("unknown policy: " + name);
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    if (argc < 7 || argc % 2 == 0)
+    {
+      std::cerr << "Usage: proxy";
+      std::cerr << " <listen_address> <listen_port>";
+      std::cerr << " <threads> <policy>";
+      std::cerr << " <target_address> <target_port>";
+      std::cerr << " [<target_address> <target_port> ...]\n";
+      std::cerr << "Policies: round_robin, least_active, power_of_two, latency_ewma\n";
+      return 1;
+    }
+
+    std::size_t num_shards = std::stoul(argv[3]);
+    if (num_shards == 0)
+      num_shards = std::thread::hardware_concurrency();
+#if !defined(SO_REUSEPORT)
+    num_shards = 1;
+#endif
+    num_shards = std::max<std::size_t>(num_shards, 1);
+
+    auto policy = parse_policy(argv[4]);
+
+    asio::io_context resolver_ctx;
+
+    auto listen_endpoint =
+      *tcp::resolver(resolver_ctx).resolve(
+          argv[1],
+          argv[2],
+          tcp::resolver::passive
+        );
+
+    std::vector<tcp::endpoint> target_endpoints;
+    for (int i = 5; i + 1 < argc; i += 2)
+    {
+      for (auto& entry : tcp::resolver(resolver_ctx).resolve(argv[i], argv[i + 1]))
+        target_endpoints.push_back(entry.endpoint());
+    }
+
+    std::vector<std::unique_ptr<shard>> shards;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      shards.push_back(
+          std::make_unique<shard>(
+            listen_endpoint,
+            policy,
+            target_endpoints
+          )
+        );
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_shards; ++i)
+    {
+      threads.emplace_back(
+          [&s = *shards[i], i]
+          {
+            try
+            {
+              s.run(i);
+            }
+            catch (std::exception& e)
+            {
+              std::cerr << "Exception: " << e.what() << "\n";
+            }
+          }
+        );
+    }
+
+    for (auto& t : threads)
+      t.join();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+  }
+}
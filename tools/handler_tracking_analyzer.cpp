@@ -0,0 +1,596 @@
+// Reads the log written to stderr by a program built with
+// ASIO_ENABLE_HANDLER_TRACKING, rebuilds the tree of handlers that caused one
+// another, and reports where the time went:
+//
+// * wait and run time distributions for each kind of operation, where wait is
+//   the time from starting an asynchronous operation to its handler being
+//   invoked, and run is the time spent inside the handler;
+// * the slowest sessions and the critical path through each of them, i.e. the
+//   causal chain of handlers that ends with the session's last completion.
+//
+// A session is the tree of handlers created by the completion of an accept
+// (or of whatever operation --session-root names). When the log contains no
+// such operation, each top-level tree of handlers is treated as a session.
+//
+// Optionally, the handlers can also be written as a Chrome trace (for
+// chrome://tracing or Perfetto), with one row per session and flow arrows
+// for causality, or as folded stacks for flamegraph.pl.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct handler
+{
+  std::uint64_t id = 0;
+  std::uint64_t parent = 0;
+  std::string op; // object type and operation, e.g. "socket.async_receive"
+  std::string location;
+  std::string result; // arguments passed to the handler, e.g. "ec=system:0"
+  std::vector<std::string> actions; // synchronous operations and reactor events
+  std::vector<std::uint64_t> children;
+  std::int64_t created = -1; // microseconds
+  std::int64_t invoked = -1;
+  std::int64_t completed = -1;
+  bool cancelled = false;
+  bool threw = false;
+  bool destroyed = false;
+  std::size_t session = 0; // 1-based, 0 if not part of a session
+};
+
+class handler_log
+{
+public:
+  // Parses one line of the log, ignoring anything not written by Asio.
+  void parse(std::string_view line)
+  {
+    constexpr std::string_view prefix = "@asio|";
+    if (!line.starts_with(prefix))
+      return;
+    line.remove_prefix(prefix.size());
+
+    std::string_view timestamp = next_field(line);
+    std::string_view action = next_field(line);
+    std::string_view description = line;
+    if (timestamp.empty() || action.empty())
+      return;
+
+    std::int64_t time = parse_timestamp(timestamp);
+
+    switch (action.front())
+    {
+    case '>':
+      if (handler* h = find(action.substr(1)))
+      {
+        h->invoked = time;
+        h->result = description;
+        h->cancelled = is_cancelled(description);
+      }
+      break;
+    case '<':
+      if (handler* h = find(action.substr(1)))
+        h->completed = time;
+      break;
+    case '!':
+      if (handler* h = find(action.substr(1)))
+      {
+        h->completed = time;
+        h->threw = true;
+      }
+      break;
+    case '~':
+      if (handler* h = find(action.substr(1)))
+      {
+        h->completed = time;
+        h->destroyed = true;
+      }
+      break;
+    case '.':
+      if (handler* h = find(action.substr(1)))
+        h->actions.emplace_back(description);
+      break;
+    default:
+      parse_relation(action, description, time);
+      break;
+    }
+  }
+
+  // Assigns each handler to a session, and returns the session roots.
+  std::vector<std::uint64_t> find_sessions(std::string_view root_op)
+  {
+    std::vector<std::uint64_t> roots;
+    for (std::uint64_t id : order_)
+    {
+      const handler& h = handlers_.at(id);
+      auto parent = handlers_.find(h.parent);
+      if (parent != handlers_.end()
+          && parent->second.op.find(root_op) != std::string::npos
+          && h.op.find(root_op) == std::string::npos)
+        roots.push_back(id);
+    }
+
+    if (roots.empty())
+    {
+      for (std::uint64_t id : order_)
+        if (!handlers_.contains(handlers_.at(id).parent))
+          roots.push_back(id);
+    }
+
+    for (std::size_t i = 0; i < roots.size(); ++i)
+      assign_session(roots[i], i + 1);
+
+    return roots;
+  }
+
+  bool contains(std::uint64_t id) const
+  {
+    return handlers_.contains(id);
+  }
+
+  const handler& at(std::uint64_t id) const
+  {
+    return handlers_.at(id);
+  }
+
+  const std::vector<std::uint64_t>& order() const
+  {
+    return order_;
+  }
+
+  std::int64_t first_timestamp() const
+  {
+    return first_timestamp_;
+  }
+
+private:
+  static std::string_view next_field(std::string_view& line)
+  {
+    auto bar = line.find('|');
+    std::string_view field = line.substr(0, bar);
+    line.remove_prefix(bar == std::string_view::npos ? line.size() : bar + 1);
+    return field;
+  }
+
+  static std::uint64_t parse_id(std::string_view text)
+  {
+    std::uint64_t id = 0;
+    for (char c : text)
+    {
+      if (c < '0' || c > '9')
+        break;
+      id = id * 10 + (c - '0');
+    }
+    return id;
+  }
+
+  // Timestamps are written as seconds.microseconds. They are kept as integer
+  // microseconds, since a double cannot hold them at full precision.
+  static std::int64_t parse_timestamp(std::string_view text)
+  {
+    auto dot = text.find('.');
+    std::int64_t seconds = parse_id(text.substr(0, dot));
+    std::int64_t microseconds = 0;
+    if (dot != std::string_view::npos)
+    {
+      std::string_view fraction = text.substr(dot + 1, 6);
+      microseconds = parse_id(fraction);
+      for (std::size_t i = fraction.size(); i < 6; ++i)
+        microseconds *= 10;
+    }
+    return seconds * 1000000 + microseconds;
+  }
+
+  static bool is_cancelled(std::string_view result)
+  {
+    std::string aborted = ":" + std::to_string(ECANCELED);
+    auto ec = result.find("ec=");
+    if (ec == std::string_view::npos)
+      return false;
+    std::string_view code = result.substr(ec, result.find(',', ec) - ec);
+    return code.ends_with(aborted);
+  }
+
+  // Turns "socket@0x7ffd5c2b9e40.async_receive" into "socket.async_receive".
+  static std::string operation_name(std::string_view description)
+  {
+    auto at = description.find('@');
+    if (at == std::string_view::npos)
+      return std::string(description);
+    auto dot = description.find('.', at);
+    std::string name(description.substr(0, at));
+    if (dot != std::string_view::npos)
+      name += description.substr(dot);
+    return name;
+  }
+
+  void parse_relation(std::string_view action,
+      std::string_view description, std::int64_t time)
+  {
+    auto separator = action.find_first_of("*^");
+    if (separator == std::string_view::npos)
+    {
+      // A synchronous operation, such as cancel or close, performed inside
+      // a handler (or outside any handler, if the id is 0).
+      if (handler* h = find(action))
+        h->actions.emplace_back(description);
+      return;
+    }
+
+    std::uint64_t parent = parse_id(action.substr(0, separator));
+    std::uint64_t id = parse_id(action.substr(separator + 1));
+    handler& h = handlers_[id];
+    if (h.id == 0)
+    {
+      h.id = id;
+      h.parent = parent;
+      h.created = time;
+      order_.push_back(id);
+      if (first_timestamp_ < 0)
+        first_timestamp_ = time;
+      if (handler* p = find(parent))
+        p->children.push_back(id);
+    }
+
+    if (action[separator] == '*')
+    {
+      h.op = operation_name(description);
+    }
+    else
+    {
+      // Source locations, innermost first.
+      if (!h.location.empty())
+        h.location += " <- ";
+      h.location += description;
+    }
+  }
+
+  handler* find(std::string_view id_text)
+  {
+    return find(parse_id(id_text));
+  }
+
+  handler* find(std::uint64_t id)
+  {
+    auto iter = handlers_.find(id);
+    return iter == handlers_.end() ? nullptr : &iter->second;
+  }
+
+  void assign_session(std::uint64_t root, std::size_t session)
+  {
+    std::vector<std::uint64_t> pending{root};
+    while (!pending.empty())
+    {
+      handler& h = handlers_.at(pending.back());
+      pending.pop_back();
+      if (h.session != 0)
+        continue;
+      h.session = session;
+      pending.insert(pending.end(), h.children.begin(), h.children.end());
+    }
+  }
+
+  std::unordered_map<std::uint64_t, handler> handlers_;
+  std::vector<std::uint64_t> order_;
+  std::int64_t first_timestamp_ = -1;
+};
+
+std::int64_t end_time(const handler& h)
+{
+  return std::max({h.created, h.invoked, h.completed});
+}
+
+struct distribution
+{
+  std::vector<std::int64_t> values;
+
+  void add(std::int64_t value)
+  {
+    values.push_back(value);
+  }
+
+  std::int64_t percentile(double p)
+  {
+    if (values.empty())
+      return 0;
+    std::sort(values.begin(), values.end());
+    auto i = static_cast<std::size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[i];
+  }
+};
+
+struct operation_stats
+{
+  std::size_t count = 0;
+  std::size_t cancelled = 0;
+  std::size_t destroyed = 0;
+  distribution wait;
+  distribution run;
+};
+
+void report_operations(std::ostream& out, const handler_log& log)
+{
+  std::map<std::string, operation_stats> operations;
+  for (std::uint64_t id : log.order())
+  {
+    const handler& h = log.at(id);
+    operation_stats& stats = operations[h.op];
+    ++stats.count;
+    if (h.cancelled)
+      ++stats.cancelled;
+    if (h.destroyed)
+      ++stats.destroyed;
+    if (h.invoked >= 0)
+      stats.wait.add(h.invoked - h.created);
+    if (h.invoked >= 0 && h.completed >= 0)
+      stats.run.add(h.completed - h.invoked);
+  }
+
+  out << "Operations (times in microseconds)\n\n";
+  out << std::left << std::setw(36) << "operation" << std::right
+    << std::setw(8) << "count" << std::setw(10) << "cancelled"
+    << std::setw(10) << "destroyed"
+    << std::setw(10) << "wait_p50" << std::setw(10) << "wait_p99" << std::setw(10) << "wait_max"
+    << std::setw(10) << "run_p50" << std::setw(10) << "run_p99" << std::setw(10) << "run_max"
+    << "\n";
+
+  for (auto& [op, stats] : operations)
+  {
+    out << std::left << std::setw(36) << op << std::right
+      << std::setw(8) << stats.count << std::setw(10) << stats.cancelled
+      << std::setw(10) << stats.destroyed
+      << std::setw(10) << stats.wait.percentile(50)
+      << std::setw(10) << stats.wait.percentile(99)
+      << std::setw(10) << stats.wait.percentile(100)
+      << std::setw(10) << stats.run.percentile(50)
+      << std::setw(10) << stats.run.percentile(99)
+      << std::setw(10) << stats.run.percentile(100)
+      << "\n";
+  }
+}
+
+// The critical path of a session is the chain of handlers, each created by
+// the one before, that leads from the session's root to its last event.
+std::vector<std::uint64_t> critical_path(const handler_log& log, std::uint64_t root)
+{
+  std::uint64_t last = root;
+  std::vector<std::uint64_t> pending{root};
+  while (!pending.empty())
+  {
+    const handler& h = log.at(pending.back());
+    pending.pop_back();
+    if (end_time(h) > end_time(log.at(last)))
+      last = h.id;
+    pending.insert(pending.end(), h.children.begin(), h.children.end());
+  }
+
+  std::vector<std::uint64_t> path;
+  for (std::uint64_t id = last;; id = log.at(id).parent)
+  {
+    path.push_back(id);
+    if (id == root)
+      break;
+  }
+
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+void report_sessions(std::ostream& out, const handler_log& log,
+    const std::vector<std::uint64_t>& roots, std::size_t slowest)
+{
+  std::vector<std::pair<std::int64_t, std::uint64_t>> spans;
+  for (std::uint64_t root : roots)
+  {
+    auto path = critical_path(log, root);
+    spans.emplace_back(end_time(log.at(path.back())) - log.at(root).created, root);
+  }
+
+  std::sort(spans.rbegin(), spans.rend());
+
+  distribution durations;
+  for (auto& [span, root] : spans)
+    durations.add(span);
+
+  out << "\nSessions: " << roots.size();
+  if (!roots.empty())
+  {
+    out << " (duration p50 " << durations.percentile(50) << "us, p99 "
+      << durations.percentile(99) << "us, max " << durations.percentile(100) << "us)";
+  }
+  out << "\n";
+
+  for (std::size_t i = 0; i < std::min(slowest, spans.size()); ++i)
+  {
+    auto [span, root] = spans[i];
+    out << "\nSession " << log.at(root).session << " took " << span << "us. Critical path:\n";
+
+    for (std::uint64_t id : critical_path(log, root))
+    {
+      const handler& h = log.at(id);
+      out << "  #" << h.id << " " << h.op;
+      if (h.invoked >= 0)
+        out << " waited " << h.invoked - h.created << "us";
+      if (h.invoked >= 0 && h.completed >= 0)
+        out << ", ran " << h.completed - h.invoked << "us";
+      if (!h.result.empty())
+        out << " [" << h.result << "]";
+      if (h.cancelled)
+        out << " cancelled";
+      if (h.destroyed)
+        out << " destroyed without being invoked";
+      if (h.threw)
+        out << " threw";
+      out << "\n";
+      if (!h.location.empty())
+        out << "      at " << h.location << "\n";
+      for (const std::string& action : h.actions)
+        out << "      " << action << "\n";
+    }
+  }
+}
+
+std::string json_escape(std::string_view text)
+{
+  std::string escaped;
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    if (static_cast<unsigned char>(c) < 0x20)
+      continue;
+    escaped += c;
+  }
+  return escaped;
+}
+
+// Writes a trace in the Chrome trace event format. Each session gets its own
+// row, each handler gets a "wait" slice and a "run" slice, and flow events
+// link every handler to the handler that created it.
+void write_chrome_trace(std::ostream& out, const handler_log& log)
+{
+  std::int64_t base = log.first_timestamp();
+  const char* separator = "\n";
+
+  out << "{\"traceEvents\":[";
+
+  auto slice = [&](const handler& h, const char* phase,
+      std::int64_t begin, std::int64_t end)
+  {
+    out << separator << "{\"name\":\"" << json_escape(h.op)
+      << "\",\"cat\":\"" << phase << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << h.session
+      << ",\"ts\":" << begin - base << ",\"dur\":" << end - begin
+      << ",\"args\":{\"id\":" << h.id << ",\"result\":\"" << json_escape(h.result)
+      << "\",\"location\":\"" << json_escape(h.location) << "\"}}";
+    separator = ",\n";
+  };
+
+  for (std::uint64_t id : log.order())
+  {
+    const handler& h = log.at(id);
+    if (h.invoked >= 0)
+    {
+      slice(h, "wait", h.created, h.invoked);
+      if (h.completed >= 0)
+        slice(h, "run", h.invoked, h.completed);
+    }
+    else if (h.completed >= 0)
+    {
+      slice(h, "wait", h.created, h.completed);
+    }
+
+    if (log.contains(h.parent) && h.invoked >= 0)
+    {
+      const handler& p = log.at(h.parent);
+      out << separator << "{\"name\":\"caused\",\"cat\":\"flow\",\"ph\":\"s\",\"pid\":1,\"tid\":"
+        << p.session << ",\"ts\":" << h.created - base << ",\"id\":" << h.id << "}";
+      out << separator << "{\"name\":\"caused\",\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":"
+        << h.session << ",\"ts\":" << h.invoked - base << ",\"id\":" << h.id << "}";
+    }
+  }
+
+  out << "\n]}\n";
+}
+
+// Writes folded stacks for flamegraph.pl, weighted in microseconds. Causal
+// chains in a session grow with every read and write, so rather than the
+// full chain each stack is the session's root operation, then the
+// operation, then whether the time was spent waiting or running.
+void write_folded_stacks(std::ostream& out, const handler_log& log,
+    const std::vector<std::uint64_t>& roots)
+{
+  std::map<std::string, std::int64_t> stacks;
+  for (std::uint64_t id : log.order())
+  {
+    const handler& h = log.at(id);
+    std::string prefix = h.session
+      ? log.at(roots[h.session - 1]).op + ";" + h.op
+      : "(no session);" + h.op;
+
+    if (h.invoked >= 0)
+    {
+      stacks[prefix + ";wait"] += h.invoked - h.created;
+      if (h.completed >= 0)
+        stacks[prefix + ";run"] += h.completed - h.invoked;
+    }
+  }
+
+  for (auto& [stack, weight] : stacks)
+    if (weight > 0)
+      out << stack << " " << weight << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+  std::string input;
+  std::string chrome_file;
+  std::string folded_file;
+  std::string session_root = "async_accept";
+  std::size_t slowest = 5;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string_view arg = argv[i];
+    if (arg == "--chrome" && i + 1 < argc)
+      chrome_file = argv[++i];
+    else if (arg == "--folded" && i + 1 < argc)
+      folded_file = argv[++i];
+    else if (arg == "--session-root" && i + 1 < argc)
+      session_root = argv[++i];
+    else if (arg == "--slowest" && i + 1 < argc)
+      slowest = std::stoul(argv[++i]);
+    else if (!arg.starts_with("--") && input.empty())
+      input = arg;
+    else
+    {
+      std::cerr << "Usage: handler_tracking_analyzer";
+      std::cerr << " [--chrome <trace.json>] [--folded <stacks.txt>]";
+      std::cerr << " [--session-root <operation>] [--slowest <n>]";
+      std::cerr << " [<log_file>]\n";
+      return 1;
+    }
+  }
+
+  std::ifstream file;
+  if (!input.empty())
+  {
+    file.open(input);
+    if (!file)
+    {
+      std::cerr << "Cannot open " << input << "\n";
+      return 1;
+    }
+  }
+
+  std::istream& in = input.empty() ? std::cin : file;
+
+  handler_log log;
+  std::string line;
+  while (std::getline(in, line))
+    log.parse(line);
+
+  auto roots = log.find_sessions(session_root);
+
+  report_operations(std::cout, log);
+  report_sessions(std::cout, log, roots, slowest);
+
+  if (!chrome_file.empty())
+  {
+    std::ofstream out(chrome_file);
+    write_chrome_trace(out, log);
+  }
+
+  if (!folded_file.empty())
+  {
+    std::ofstream out(folded_file);
+    write_folded_stacks(out, log, roots);
+  }
+}